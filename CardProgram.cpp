@@ -0,0 +1,95 @@
+#include "CardProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "gl_errors.hpp"
+
+Load< CardProgram > card_program(LoadTagEarly);
+
+CardProgram::CardProgram() {
+	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform mat4 OBJECT_TO_CLIP;\n"
+		"in vec4 Rect;\n" //per-instance: min.xy, max.xy
+		"in vec4 Fill;\n"
+		"in vec4 Border;\n"
+		"in vec4 LabelColor;\n"
+		"in float Label;\n" //atlas cell; 64 and up mean 'no label'
+
+		"out vec2 position;\n"
+		"flat out vec4 rect;\n"
+		"flat out vec4 fill;\n"
+		"flat out vec4 border;\n"
+		"flat out vec4 labelColor;\n"
+		"flat out float label;\n"
+		"void main() {\n"
+		//the unit card is generated from the vertex index (drawn as a 4-vertex triangle strip):
+		"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+		"	position = mix(Rect.xy, Rect.zw, corner);\n"
+		"	gl_Position = OBJECT_TO_CLIP * vec4(position, 0.0, 1.0);\n"
+		"	rect = Rect;\n"
+		"	fill = Fill;\n"
+		"	border = Border;\n"
+		"	labelColor = LabelColor;\n"
+		"	label = Label;\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"uniform sampler2D LABELS;\n"
+		"uniform vec2 LABEL_OFFSET;\n"
+		"uniform float LABEL_HEIGHT;\n"
+		"in vec2 position;\n"
+		"flat in vec4 rect;\n"
+		"flat in vec4 fill;\n"
+		"flat in vec4 border;\n"
+		"flat in vec4 labelColor;\n"
+		"flat in float label;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		//label space has the label's anchor at the origin and is 1 unit per LABEL_HEIGHT;
+		// (LABEL_OFFSET and LABEL_HEIGHT are in units of card height, so labels scale with their cards)
+		// each atlas cell covers [-0.25,3.75]x[-0.25,1.25] of label space, in an 8x8 grid of cells:
+		"	vec2 at = ((position - rect.xy) / (rect.w - rect.y) - LABEL_OFFSET) / LABEL_HEIGHT;\n"
+		"	vec2 cell = (at - vec2(-0.25)) / vec2(4.0, 1.5);\n"
+		"	float index = min(label, 63.0);\n"
+		"	vec2 uv = (vec2(mod(index, 8.0), floor(index / 8.0)) + clamp(cell, 0.0, 1.0)) / 8.0;\n"
+		"	float ink = texture(LABELS, uv).r;\n" //(sampled outside any branch so mip selection works)
+		"	if (label > 63.5 || any(lessThan(cell, vec2(0.0))) || any(greaterThan(cell, vec2(1.0)))) ink = 0.0;\n"
+		"	vec4 color = mix(fill, labelColor, ink * labelColor.a);\n"
+		//one-pixel outline:
+		"	vec2 px = fwidth(position);\n"
+		"	vec2 edge = min(position - rect.xy, rect.zw - position) / px;\n"
+		"	if (min(edge.x, edge.y) < 1.0) color = border;\n"
+		"	fragColor = color;\n"
+		"}\n"
+	);
+	//As you can see above, adjacent strings in C/C++ are concatenated.
+	// this is very useful for writing long shader programs inline.
+
+	//look up the locations of vertex attributes:
+	Rect_vec4 = glGetAttribLocation(program, "Rect");
+	Fill_vec4 = glGetAttribLocation(program, "Fill");
+	Border_vec4 = glGetAttribLocation(program, "Border");
+	LabelColor_vec4 = glGetAttribLocation(program, "LabelColor");
+	Label_float = glGetAttribLocation(program, "Label");
+
+	//look up the locations of uniforms:
+	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
+	LABEL_OFFSET_vec2 = glGetUniformLocation(program, "LABEL_OFFSET");
+	LABEL_HEIGHT_float = glGetUniformLocation(program, "LABEL_HEIGHT");
+	GLuint LABELS_sampler2D = glGetUniformLocation(program, "LABELS");
+
+	//set LABELS to always refer to texture binding zero:
+	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+
+	glUniform1i(LABELS_sampler2D, 0); //set LABELS to sample from GL_TEXTURE0
+
+	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+}
+
+CardProgram::~CardProgram() {
+	glDeleteProgram(program);
+	program = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+//Shader program that draws instanced, filled card rectangles with an outline and a label from an atlas:
+// (see DrawCards for the per-instance data)
+struct CardProgram {
+	CardProgram();
+	~CardProgram();
+
+	GLuint program = 0;
+	//Attribute (per-instance variable) locations:
+	GLuint Rect_vec4 = -1U;
+	GLuint Fill_vec4 = -1U;
+	GLuint Border_vec4 = -1U;
+	GLuint LabelColor_vec4 = -1U;
+	GLuint Label_float = -1U;
+	//Uniform (per-invocation variable) locations:
+	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+	GLuint LABEL_OFFSET_vec2 = -1U;
+	GLuint LABEL_HEIGHT_float = -1U;
+	//Textures:
+	//TEXTURE0 - label atlas (see DrawCards.cpp)
+};
+
+extern Load< CardProgram > card_program;
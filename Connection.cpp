@@ -59,7 +59,8 @@ void poll_connections(
 	std::list< Connection > &connections,
 	std::function< void(Connection *, Connection::Event event) > const &on_event,
 	double timeout,
-	Socket listen_socket = InvalidSocket) {
+	Socket listen_socket = InvalidSocket,
+	int wake_fd = -1) {
 
 	fd_set read_fds, write_fds;
 	FD_ZERO(&read_fds);
@@ -73,6 +74,15 @@ void poll_connections(
 		FD_SET(listen_socket, &read_fds);
 	}
 
+	//add wake_fd (e.g., a timer) to read set if needed:
+	// (it is only waited on, never read here; whoever owns it reads it)
+	#ifndef _WIN32
+	if (wake_fd >= 0) {
+		max = std::max(max, wake_fd);
+		FD_SET(wake_fd, &read_fds);
+	}
+	#endif
+
 	//add each connection's socket to read (and possibly write) sets:
 	for (auto c : connections) {
 		if (c.socket != InvalidSocket) {
@@ -274,8 +284,8 @@ Server::Server(std::string const &port) {
 	}
 }
 
-void Server::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+void Server::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout, int wake_fd) {
+	poll_connections("Server::poll", connections, on_event, timeout, listen_socket, wake_fd);
 
 	//reap closed clients:
 	for (auto connection = connections.begin(); connection != connections.end(); /*later*/) {
@@ -102,10 +102,11 @@ struct Server {
 	Server(std::string const &port); //pass the port number to listen on, as a string (servname, really)
 
 	//poll() updates the list of active connections and sends/receives data if possible:
-	// (will wait up to 'timeout' for first event)
+	// (will wait up to 'timeout' for first event, or until 'wake_fd' -- if given -- becomes readable)
 	void poll(
 		std::function< void(Connection *, Connection::Event event) > const &connection_event = nullptr,
-		double timeout = 0.0 //timeout (seconds)
+		double timeout = 0.0, //timeout (seconds)
+		int wake_fd = -1 //extra file descriptor to wait on, e.g. TickScheduler::wake_fd() (ignored on windows)
 	);
 
 	std::list< Connection > connections;
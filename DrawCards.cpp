@@ -0,0 +1,171 @@
+#include "DrawCards.hpp"
+#include "CardProgram.hpp"
+#include "PathFont.hpp"
+#include "StreamBuffer.hpp"
+
+#include "gl_errors.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+//All DrawCards instances share a vertex array object and the label atlas, initialized at load time;
+// instances go through the shared stream_buffer ring (see StreamBuffer.hpp):
+
+//n.b. declared static so they don't conflict with similarly named global variables elsewhere:
+static GLuint instances_for_card_program = 0;
+static GLuint label_atlas = 0;
+
+//atlas layout (must match CardProgram's fragment shader):
+static constexpr uint32_t AtlasCells = 8; //cells per row / column
+static constexpr uint32_t CellWidth = 128, CellHeight = 48; //pixels; cell covers [-0.25,3.75]x[-0.25,1.25] of label space
+static constexpr float CellPixelsPerUnit = 32.0f;
+
+//text for each label (suit letter, space, rank):
+static std::string label_text(uint32_t label) {
+	static char const *suits[4] = {"D", "H", "C", "S"};
+	static char const *ranks[13] = {"A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K"};
+	if (label < 52) return std::string(suits[label / 13]) + " " + ranks[label % 13];
+	else if (label < 56) return std::string(suits[label - 52]) + " ";
+	else if (label == DrawCards::LabelEnd) return "end";
+	else if (label == DrawCards::LabelNone) return "none";
+	else return "";
+}
+
+//distance from p to segment [a,b]:
+static float segment_distance(glm::vec2 const &p, glm::vec2 const &a, glm::vec2 const &b) {
+	glm::vec2 ab = b - a;
+	float len2 = glm::dot(ab, ab);
+	float t = (len2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f);
+	return glm::length(p - (a + t * ab));
+}
+
+//label atlas pixels, from rasterization (on a loading thread) until upload:
+static std::vector< uint8_t > label_atlas_pixels;
+static constexpr uint32_t AtlasWidth = AtlasCells * CellWidth, AtlasHeight = AtlasCells * CellHeight;
+
+static Load< void > setup_cards(LoadAfter{ &card_program }, [](){
+	{ //rasterize label atlas from PathFont's line glyphs:
+		constexpr uint32_t Width = AtlasWidth, Height = AtlasHeight;
+		std::vector< uint8_t > &pixels = label_atlas_pixels;
+		pixels.assign(Width * Height, 0);
+		constexpr float StrokeRadius = 1.25f; //pixels
+
+		std::vector< glm::vec2 > points;
+		for (uint32_t label = 0; label < AtlasCells * AtlasCells; ++label) {
+			std::string text = label_text(label);
+			if (text.empty()) continue;
+			points.clear();
+			PathFont::font.layout(text, &points);
+
+			//to cell pixels:
+			glm::vec2 origin = glm::vec2((label % AtlasCells) * CellWidth, (label / AtlasCells) * CellHeight) + glm::vec2(0.25f * CellPixelsPerUnit);
+			for (auto &pt : points) pt = origin + pt * CellPixelsPerUnit;
+
+			//coverage of each pixel near each stroke:
+			for (uint32_t i = 0; i + 1 < points.size(); i += 2) {
+				glm::vec2 a = points[i], b = points[i+1];
+				glm::ivec2 lo = glm::ivec2(glm::floor(glm::min(a, b) - StrokeRadius - 1.0f));
+				glm::ivec2 hi = glm::ivec2(glm::ceil(glm::max(a, b) + StrokeRadius + 1.0f));
+				lo = glm::max(lo, glm::ivec2(0));
+				hi = glm::min(hi, glm::ivec2(Width - 1, Height - 1));
+				for (int32_t y = lo.y; y <= hi.y; ++y) {
+					for (int32_t x = lo.x; x <= hi.x; ++x) {
+						float d = segment_distance(glm::vec2(x + 0.5f, y + 0.5f), a, b);
+						float coverage = glm::clamp(StrokeRadius + 0.5f - d, 0.0f, 1.0f);
+						uint8_t &px = pixels[y * Width + x];
+						px = std::max(px, uint8_t(coverage * 255.0f));
+					}
+				}
+			}
+		}
+	}
+}, [](){
+	{ //upload label atlas:
+		glGenTextures(1, &label_atlas);
+		glBindTexture(GL_TEXTURE_2D, label_atlas);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, AtlasWidth, AtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, label_atlas_pixels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		//cells have a quarter-unit (8 pixel) margin, so stop mipmapping before neighbors bleed together:
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		label_atlas_pixels = std::vector< uint8_t >(); //(free memory)
+	}
+
+	{ //vertex array for card_program (attribute pointers are set per-draw, since the offset changes):
+		glGenVertexArrays(1, &instances_for_card_program);
+		glBindVertexArray(instances_for_card_program);
+		for (GLuint attrib : {card_program->Rect_vec4, card_program->Fill_vec4, card_program->Border_vec4, card_program->LabelColor_vec4, card_program->Label_float}) {
+			glEnableVertexAttribArray(attrib);
+			glVertexAttribDivisor(attrib, 1); //one value per card, not per vertex
+		}
+		glBindVertexArray(0);
+	}
+
+	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
+});
+
+
+DrawCards::DrawCards(glm::mat4 const &world_to_clip_) : world_to_clip(world_to_clip_) {
+}
+
+uint16_t DrawCards::card_label(int suit, int rank) {
+	if (suit < 0 || suit >= 4 || rank < -1 || rank >= 13) return NoLabel;
+	if (rank == -1) return uint16_t(52 + suit);
+	return uint16_t(suit * 13 + rank);
+}
+
+void DrawCards::draw(glm::vec2 const &min, glm::vec2 const &max, glm::u8vec4 const &fill, glm::u8vec4 const &border, uint16_t label, glm::u8vec4 const &label_color) {
+	instances.emplace_back(glm::min(min, max), glm::max(min, max), fill, border, label_color, label);
+}
+
+DrawCards::~DrawCards() {
+	if (instances.empty()) return;
+
+	//upload instances to the stream buffer:
+	GLintptr offset = stream_buffer->upload(instances.data(), instances.size() * sizeof(instances[0]), sizeof(instances[0]));
+
+	//point the vertex array at this batch of instances:
+	glBindVertexArray(instances_for_card_program);
+	glBindBuffer(GL_ARRAY_BUFFER, stream_buffer->buffer);
+	auto attrib = [&](GLuint location, GLint size, GLenum type, GLboolean normalized, size_t member) {
+		glVertexAttribPointer(location, size, type, normalized, sizeof(Instance), (GLbyte *)0 + offset + member);
+	};
+	attrib(card_program->Rect_vec4, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, Rect));
+	attrib(card_program->Fill_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Instance, Fill));
+	attrib(card_program->Border_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Instance, Border));
+	attrib(card_program->LabelColor_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Instance, LabelColor));
+	attrib(card_program->Label_float, 1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(Instance, Label));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//set card_program as current program:
+	glUseProgram(card_program->program);
+
+	//upload uniforms:
+	glUniformMatrix4fv(card_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+	glUniform2fv(card_program->LABEL_OFFSET_vec2, 1, glm::value_ptr(label_offset));
+	glUniform1f(card_program->LABEL_HEIGHT_float, label_height);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, label_atlas);
+
+	//run the OpenGL pipeline -- every card in one call:
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances.size()));
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//reset vertex array to none:
+	glBindVertexArray(0);
+
+	//reset current program to none:
+	glUseProgram(0);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * Helper for drawing cards as filled, outlined, labeled rectangles.
+ *
+ * Cards are collected as instances and drawn with a single instanced draw call
+ * (CardProgram) when the DrawCards goes out of scope -- same usage pattern as DrawLines.
+ *
+ * Labels come from an atlas built at load time from PathFont, with one cell per
+ * card ("D A" ... "S K"), per empty suit pile ("D " ...), and for "end" / "none".
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+struct DrawCards {
+	//Start drawing; will remember world_to_clip matrix:
+	DrawCards(glm::mat4 const &world_to_clip);
+
+	//label indices:
+	enum : uint16_t {
+		LabelEnd = 56,
+		LabelNone = 57,
+		NoLabel = 0xffff,
+	};
+	//label for a card (rank -1 gives just the suit, as shown on an empty suit pile):
+	static uint16_t card_label(int suit, int rank);
+
+	//draw a card covering [min,max] (in world space):
+	void draw(glm::vec2 const &min, glm::vec2 const &max,
+		glm::u8vec4 const &fill, glm::u8vec4 const &border,
+		uint16_t label = NoLabel, glm::u8vec4 const &label_color = glm::u8vec4(0xff));
+
+	//where labels go, relative to the lower-left corner of each card (in units of that card's height):
+	// (so cards drawn smaller -- e.g., on a far-away board -- get proportionally smaller labels)
+	glm::vec2 label_offset = glm::vec2(0.0f);
+	float label_height = 1.0f; //(height of a capital letter is a little less than this)
+
+	//Finish drawing (push instances to GPU):
+	~DrawCards();
+
+
+	glm::mat4 world_to_clip;
+	struct Instance {
+		Instance(glm::vec2 const &min, glm::vec2 const &max, glm::u8vec4 const &Fill_, glm::u8vec4 const &Border_, glm::u8vec4 const &LabelColor_, uint16_t Label_)
+			: Rect(min, max), Fill(Fill_), Border(Border_), LabelColor(LabelColor_), Label(Label_) { }
+		glm::vec4 Rect;
+		glm::u8vec4 Fill;
+		glm::u8vec4 Border;
+		glm::u8vec4 LabelColor;
+		uint16_t Label;
+		uint16_t padding = 0;
+	};
+	static_assert(sizeof(Instance) == 32, "Instance is packed.");
+	std::vector< Instance > instances;
+};
@@ -1,24 +1,26 @@
 #include "DrawLines.hpp"
 #include "PathFont.hpp"
 #include "ColorProgram.hpp"
+#include "StreamBuffer.hpp"
 
 #include "gl_errors.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-//All DrawLines instances share a vertex array object and vertex buffer, initialized at load time:
+#include <unordered_map>
+
+//All DrawLines instances share a vertex array object, initialized at load time;
+// vertices go through the shared stream_buffer ring (see StreamBuffer.hpp):
 
 //n.b. declared static so they don't conflict with similarly named global variables elsewhere:
-static GLuint vertex_buffer = 0;
 static GLuint vertex_buffer_for_color_program = 0;
 
 static Load< void > setup_buffers(LoadTagDefault, [](){
 	//you may recognize this init code from DrawSprites.cpp:
 
-	{ //set up vertex buffer:
-		glGenBuffers(1, &vertex_buffer);
-		//for now, buffer will be un-filled.
-	}
+	//(stream_buffer is set up at LoadTagEarly)
+	assert(stream_buffer);
+	GLuint vertex_buffer = stream_buffer->buffer;
 
 	{ //vertex array mapping buffer for color_program:
 		//ask OpenGL to fill vertex_buffer_for_color_program with the name of an unused vertex array object:
@@ -97,46 +99,39 @@ void DrawLines::draw_quad(float xmin, float ymin, float xmax, float ymax, glm::u
 	draw(glm::vec3(xmax, ymin, 0.0f), glm::vec3(xmax, ymax, 0.0f), color);
 }
 
-void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor_in, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) {
-
-	glm::vec3 anchor = anchor_in;
-
-	uint32_t start = 0;
-	while (start < text.size()) {
-		uint32_t end = start;
-		uint32_t glyph = -1U;
-		while (end < text.size()) {
-			end += 1;
-			auto f = PathFont::font.glyph_map.find(text.substr(start, end-start));
-			if (f == PathFont::font.glyph_map.end()) {
-				end -= 1;
-				break;
-			}
-			glyph = f->second;
-		}
-		if (glyph == -1U) {
-			assert(start == end);
-			end += 1;
-			//missing! draw a tofu:
-			for (const auto &pt : {
-				glm::vec2(0.1f, 0.1f), glm::vec2(0.6f, 0.1f),
-				glm::vec2(0.6f, 0.1f), glm::vec2(0.6f, 0.9f),
-				glm::vec2(0.9f, 0.6f), glm::vec2(0.1f, 0.9f),
-				glm::vec2(0.1f, 0.9f), glm::vec2(0.1f, 0.1f)
-			}) {
-				attribs.emplace_back(anchor + pt.x * x + pt.y * y, color);
-			}
-			anchor += x * 0.6f;
-		} else {
-			for (uint32_t c = PathFont::font.glyph_coord_starts[glyph]; c + 1 < PathFont::font.glyph_coord_starts[glyph+1]; c += 2) {
-				attribs.emplace_back(anchor + x * PathFont::font.coords[c] + y * PathFont::font.coords[c+1], color);
-			}
-			anchor += x * PathFont::font.glyph_widths[glyph];
-		}
-		start = end;
+//Text is laid out once per distinct string, in glyph units (anchor at the origin, x and y unit vectors),
+// then emitted through each draw's anchor/x/y. PlayMode draws the same few labels every frame,
+// so after the first frame draw_text is only a hash lookup and a transform per vertex:
+namespace {
+	struct TextRun {
+		std::vector< glm::vec2 > points; //pairs of line endpoints
+		float advance = 0.0f; //total width
+	};
+}
+
+static std::unordered_map< std::string, TextRun > text_runs;
+//strings like scores change over time, so start over rather than grow without limit:
+static constexpr size_t MaxTextRuns = 1024;
+
+static TextRun const &text_run(std::string const &text) {
+	auto f = text_runs.find(text);
+	if (f != text_runs.end()) return f->second;
+
+	if (text_runs.size() >= MaxTextRuns) text_runs.clear();
+	TextRun &run = text_runs[text];
+	run.advance = PathFont::font.layout(text, &run.points);
+
+	return run;
+}
+
+void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) {
+	TextRun const &run = text_run(text);
+
+	for (auto const &pt : run.points) {
+		attribs.emplace_back(anchor + x * pt.x + y * pt.y, color);
 	}
 
-	if (anchor_out) *anchor_out = anchor;
+	if (anchor_out) *anchor_out = anchor + x * run.advance;
 }
 
 DrawLines::~DrawLines() {
@@ -144,10 +139,8 @@ DrawLines::~DrawLines() {
 
 	//based on DrawSprites.cpp :
 
-	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
-	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_STREAM_DRAW); //upload attribs array
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//upload vertices to the stream buffer (aligned so the offset is a whole number of vertices):
+	GLintptr offset = stream_buffer->upload(attribs.data(), attribs.size() * sizeof(attribs[0]), sizeof(attribs[0]));
 
 	//set color_program as current program:
 	glUseProgram(color_program->program);
@@ -159,7 +152,7 @@ DrawLines::~DrawLines() {
 	glBindVertexArray(vertex_buffer_for_color_program);
 
 	//run the OpenGL pipeline:
-	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
+	glDrawArrays(GL_LINES, GLint(offset / sizeof(attribs[0])), GLsizei(attribs.size()));
 
 	//reset vertex array to none:
 	glBindVertexArray(0);
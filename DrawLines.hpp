@@ -27,7 +27,7 @@ struct DrawLines {
 	void draw_quad(float xmin, float ymin, float xmax, float ymax, glm::u8vec4 const &color);
 
 	//draw wireframe text, start at anchor, move in x direction, mat gives x and y directions for text drawing:
-	// (default character box is 1 unit high)
+	// (default character box is 1 unit high; layout is cached per string, so redrawing the same text is cheap)
 	void draw_text(std::string const &text,
 		glm::vec3 const &anchor,
 		glm::vec3 const &x = glm::vec3(1.0f, 0.0f, 0.0f),
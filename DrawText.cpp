@@ -0,0 +1,211 @@
+#include "DrawText.hpp"
+#include "TextProgram.hpp"
+#include "PathFont.hpp"
+#include "StreamBuffer.hpp"
+
+#include "gl_errors.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+//All DrawText instances share a vertex array object and the glyph atlas, initialized at load time;
+// instances go through the shared stream_buffer ring (see StreamBuffer.hpp):
+
+//n.b. declared static so they don't conflict with similarly named global variables elsewhere:
+static GLuint instances_for_text_program = 0;
+static GLuint glyph_atlas = 0;
+
+//atlas layout (must match TextProgram's shaders):
+static constexpr uint32_t AtlasColumns = 16, AtlasRows = 6; //cells; one per PathFont glyph, plus a tofu
+static constexpr glm::vec2 CellMin = glm::vec2(-0.375f, -0.75f); //glyph units
+static constexpr glm::vec2 CellMax = glm::vec2(1.0f, 1.375f);
+static constexpr float CellPixelsPerUnit = 32.0f;
+static constexpr uint32_t CellWidth = uint32_t((CellMax.x - CellMin.x) * CellPixelsPerUnit); //44
+static constexpr uint32_t CellHeight = uint32_t((CellMax.y - CellMin.y) * CellPixelsPerUnit); //68
+static constexpr float MaxDistance = 0.25f; //glyph units; distances are stored as 1 - distance / MaxDistance
+
+//drawn for characters without glyphs (same as PathFont::layout's):
+static const std::array< glm::vec2, 8 > Tofu{
+	glm::vec2(0.1f, 0.1f), glm::vec2(0.6f, 0.1f),
+	glm::vec2(0.6f, 0.1f), glm::vec2(0.6f, 0.9f),
+	glm::vec2(0.9f, 0.6f), glm::vec2(0.1f, 0.9f),
+	glm::vec2(0.1f, 0.9f), glm::vec2(0.1f, 0.1f)
+};
+static constexpr float TofuAdvance = 0.6f;
+
+//distance from p to segment [a,b]:
+static float segment_distance(glm::vec2 const &p, glm::vec2 const &a, glm::vec2 const &b) {
+	glm::vec2 ab = b - a;
+	float len2 = glm::dot(ab, ab);
+	float t = (len2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f);
+	return glm::length(p - (a + t * ab));
+}
+
+//glyph atlas distances, from building (on a loading thread) until upload:
+static std::vector< uint8_t > glyph_atlas_pixels;
+static constexpr uint32_t AtlasWidth = AtlasColumns * CellWidth, AtlasHeight = AtlasRows * CellHeight;
+
+static Load< void > setup_text(LoadAfter{ &text_program }, [](){
+	PathFont const &font = PathFont::font;
+	if (font.glyphs + 1 > AtlasColumns * AtlasRows) {
+		throw std::runtime_error("PathFont has " + std::to_string(font.glyphs) + " glyphs, but the text atlas only fits " + std::to_string(AtlasColumns * AtlasRows - 1) + ".");
+	}
+
+	{ //build distance atlas from PathFont's line glyphs:
+		constexpr uint32_t Width = AtlasWidth, Height = AtlasHeight;
+		std::vector< uint8_t > &pixels = glyph_atlas_pixels;
+		pixels.assign(Width * Height, 0);
+		constexpr float Reach = MaxDistance * CellPixelsPerUnit; //pixels
+
+		for (uint32_t glyph = 0; glyph <= font.glyphs; ++glyph) {
+			//glyph strokes as segment endpoint pairs:
+			std::vector< glm::vec2 > points;
+			if (glyph == font.glyphs) {
+				points.assign(Tofu.begin(), Tofu.end());
+			} else {
+				for (uint32_t c = font.glyph_coord_starts[glyph]; c + 1 < font.glyph_coord_starts[glyph+1]; c += 2) {
+					points.emplace_back(font.coords[c], font.coords[c+1]);
+				}
+			}
+
+			//to atlas pixels:
+			glm::vec2 origin = glm::vec2((glyph % AtlasColumns) * CellWidth, (glyph / AtlasColumns) * CellHeight) - CellMin * CellPixelsPerUnit;
+			for (auto &pt : points) pt = origin + pt * CellPixelsPerUnit;
+
+			//nearest stroke distance, for pixels within reach of each stroke (and inside the cell):
+			glm::ivec2 cell_lo = glm::ivec2((glyph % AtlasColumns) * CellWidth, (glyph / AtlasColumns) * CellHeight);
+			glm::ivec2 cell_hi = cell_lo + glm::ivec2(CellWidth - 1, CellHeight - 1);
+			for (uint32_t i = 0; i + 1 < points.size(); i += 2) {
+				glm::vec2 a = points[i], b = points[i+1];
+				glm::ivec2 lo = glm::max(glm::ivec2(glm::floor(glm::min(a, b) - Reach)), cell_lo);
+				glm::ivec2 hi = glm::min(glm::ivec2(glm::ceil(glm::max(a, b) + Reach)), cell_hi);
+				for (int32_t y = lo.y; y <= hi.y; ++y) {
+					for (int32_t x = lo.x; x <= hi.x; ++x) {
+						float d = segment_distance(glm::vec2(x + 0.5f, y + 0.5f), a, b);
+						float value = glm::clamp(1.0f - d / Reach, 0.0f, 1.0f);
+						uint8_t &px = pixels[y * Width + x];
+						px = std::max(px, uint8_t(value * 255.0f + 0.5f));
+					}
+				}
+			}
+		}
+	}
+}, [](){
+	{ //upload distance atlas:
+		glGenTextures(1, &glyph_atlas);
+		glBindTexture(GL_TEXTURE_2D, glyph_atlas);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, AtlasWidth, AtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, glyph_atlas_pixels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		//(distances interpolate well, so no mipmaps; cells fade to zero at their edges, so neighbors don't bleed)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glyph_atlas_pixels = std::vector< uint8_t >(); //(free memory)
+	}
+
+	{ //vertex array for text_program (attribute pointers are set per-draw, since the offset changes):
+		glGenVertexArrays(1, &instances_for_text_program);
+		glBindVertexArray(instances_for_text_program);
+		for (GLuint attrib : {text_program->Origin_vec2, text_program->X_vec2, text_program->Y_vec2, text_program->Color_vec4, text_program->Glyph_float}) {
+			glEnableVertexAttribArray(attrib);
+			glVertexAttribDivisor(attrib, 1); //one value per glyph, not per vertex
+		}
+		glBindVertexArray(0);
+	}
+
+	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
+});
+
+
+DrawText::DrawText(glm::mat4 const &world_to_clip_) : world_to_clip(world_to_clip_) {
+}
+
+float DrawText::draw(std::string const &text, glm::vec2 const &anchor, glm::vec2 const &x, glm::vec2 const &y, glm::u8vec4 const &color) {
+	PathFont const &font = PathFont::font;
+
+	float advance = 0.0f;
+	char const *at = text.data();
+	char const *end = text.data() + text.size();
+	while (at != end) {
+		uint32_t glyph;
+		uint32_t matched = font.match(at, end, &glyph);
+		float width;
+		if (matched == 0) {
+			matched = 1;
+			glyph = font.glyphs; //tofu
+			width = TofuAdvance;
+		} else {
+			width = font.glyph_widths[glyph];
+		}
+
+		//(spaces and the like have no strokes, so skip them)
+		if (glyph == font.glyphs || font.glyph_coord_starts[glyph] != font.glyph_coord_starts[glyph+1]) {
+			Instance instance;
+			instance.Origin = anchor + advance * x;
+			instance.X = x;
+			instance.Y = y;
+			instance.Color = color;
+			instance.Glyph = uint16_t(glyph);
+			instances.emplace_back(instance);
+		}
+
+		advance += width;
+		at += matched;
+	}
+	return advance;
+}
+
+DrawText::~DrawText() {
+	if (instances.empty()) return;
+
+	//upload instances to the stream buffer:
+	GLintptr offset = stream_buffer->upload(instances.data(), instances.size() * sizeof(instances[0]), sizeof(instances[0]));
+
+	//point the vertex array at this batch of instances:
+	glBindVertexArray(instances_for_text_program);
+	glBindBuffer(GL_ARRAY_BUFFER, stream_buffer->buffer);
+	auto attrib = [&](GLuint location, GLint size, GLenum type, GLboolean normalized, size_t member) {
+		glVertexAttribPointer(location, size, type, normalized, sizeof(Instance), (GLbyte *)0 + offset + member);
+	};
+	attrib(text_program->Origin_vec2, 2, GL_FLOAT, GL_FALSE, offsetof(Instance, Origin));
+	attrib(text_program->X_vec2, 2, GL_FLOAT, GL_FALSE, offsetof(Instance, X));
+	attrib(text_program->Y_vec2, 2, GL_FLOAT, GL_FALSE, offsetof(Instance, Y));
+	attrib(text_program->Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Instance, Color));
+	attrib(text_program->Glyph_float, 1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(Instance, Glyph));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//set text_program as current program:
+	glUseProgram(text_program->program);
+
+	//upload uniforms:
+	glUniformMatrix4fv(text_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+	glUniform1f(text_program->WEIGHT_float, weight);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, glyph_atlas);
+
+	//glyph quads overlap, so blend:
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	//run the OpenGL pipeline -- every glyph in one call:
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances.size()));
+
+	glDisable(GL_BLEND);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//reset vertex array to none:
+	glBindVertexArray(0);
+
+	//reset current program to none:
+	glUseProgram(0);
+}
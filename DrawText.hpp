@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Helper for drawing text as one textured quad per glyph.
+ *
+ * Glyphs are collected as instances and drawn with a single instanced draw call
+ * (TextProgram) when the DrawText goes out of scope -- same usage pattern as DrawLines.
+ *
+ * Glyphs come from a distance field atlas built at load time from PathFont's
+ * strokes, so text stays crisp at any size and stroke weight is a uniform rather
+ * than something to fake by drawing twice.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct DrawText {
+	//Start drawing; will remember world_to_clip matrix:
+	DrawText(glm::mat4 const &world_to_clip);
+
+	//draw text starting at 'anchor' (on the baseline), with glyph +x along 'x' and +y along 'y':
+	// (so text is |y| high; same convention as DrawLines::draw_text); returns the advance, in glyph units
+	float draw(std::string const &text, glm::vec2 const &anchor,
+		glm::vec2 const &x = glm::vec2(1.0f, 0.0f), glm::vec2 const &y = glm::vec2(0.0f, 1.0f),
+		glm::u8vec4 const &color = glm::u8vec4(0xff));
+
+	//half-width of strokes, in glyph units:
+	// (strokes are always drawn at least about a pixel and a half wide)
+	float weight = 0.03f;
+
+	//Finish drawing (push instances to GPU):
+	~DrawText();
+
+
+	glm::mat4 world_to_clip;
+	struct Instance {
+		glm::vec2 Origin;
+		glm::vec2 X;
+		glm::vec2 Y;
+		glm::u8vec4 Color;
+		uint16_t Glyph;
+		uint16_t padding = 0;
+	};
+	static_assert(sizeof(Instance) == 32, "Instance is packed.");
+	std::vector< Instance > instances;
+};
@@ -0,0 +1,165 @@
+#include "FlatScene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+glm::mat4 FlatScene::Camera::make_projection() const {
+	return glm::infinitePerspective( fovy, aspect, near );
+}
+
+void FlatScene::update_transforms(uint32_t begin, uint32_t end) {
+	assert(begin <= end && end <= parents.size());
+	//(sized by the single-threaded overload below, since resizing here would race with other ranges)
+	assert(local_to_world.size() == parents.size());
+
+	for (uint32_t i = begin; i < end; ++i) {
+		//same as Scene::Transform::make_local_to_parent:
+		glm::mat3 rot = glm::mat3_cast(rotations[i]);
+		glm::mat4x3 local_to_parent = glm::mat4x3(
+			rot[0] * scales[i].x,
+			rot[1] * scales[i].y,
+			rot[2] * scales[i].z,
+			positions[i]
+		);
+		if (parents[i] == -1U) {
+			local_to_world[i] = local_to_parent;
+		} else {
+			assert(parents[i] < i);
+			local_to_world[i] = local_to_world[parents[i]] * glm::mat4(local_to_parent); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		}
+	}
+}
+
+void FlatScene::update_transforms() {
+	local_to_world.resize(parents.size());
+	update_transforms(0, uint32_t(parents.size()));
+}
+
+void FlatScene::draw(Camera const &camera) const {
+	assert(camera.transform < local_to_world.size());
+	glm::mat4 world_to_clip = camera.make_projection() * glm::inverse(glm::mat4(local_to_world[camera.transform]));
+	glm::mat4x3 world_to_light = glm::mat4x3(1.0f);
+	draw(world_to_clip, world_to_light);
+}
+
+void FlatScene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	if (local_to_world.size() != parents.size()) {
+		throw std::runtime_error("FlatScene::draw called before update_transforms.");
+	}
+
+	draw_list.clear();
+	draw_list.reserve(drawables.size());
+	for (auto const &drawable : drawables) {
+		draw_list.emplace_back(Scene::DrawItem{&drawable.pipeline, &local_to_world[drawable.transform]});
+	}
+
+	Scene::draw_items(draw_list, &draw_queue, world_to_clip, world_to_light);
+}
+
+uint32_t FlatScene::find(std::string const &name) const {
+	auto f = std::find(names.begin(), names.end(), name);
+	if (f == names.end()) return -1U;
+	return uint32_t(f - names.begin());
+}
+
+FlatScene::FlatScene(Scene const &scene) {
+	set(scene);
+}
+
+void FlatScene::set(Scene const &scene, std::unordered_map< Scene::Transform const *, uint32_t > *transform_map_) {
+	std::unordered_map< Scene::Transform const *, uint32_t > t2i_temp;
+	std::unordered_map< Scene::Transform const *, uint32_t > &transform_to_index = *(transform_map_ ? transform_map_ : &t2i_temp);
+	transform_to_index.clear();
+
+	//depth of every transform in the hierarchy (memoized, so this is linear in the number of transforms):
+	std::unordered_map< Scene::Transform const *, uint32_t > depths;
+	std::vector< Scene::Transform const * > chain;
+	for (auto const &transform : scene.transforms) {
+		chain.clear();
+		Scene::Transform const *t = &transform;
+		while (t && depths.count(t) == 0) {
+			chain.emplace_back(t);
+			t = t->parent;
+			if (chain.size() > scene.transforms.size()) throw std::runtime_error("Scene has a cycle in its transform hierarchy.");
+		}
+		uint32_t depth = (t ? depths.at(t) + 1 : 0);
+		for (auto c = chain.rbegin(); c != chain.rend(); ++c) {
+			depths.emplace(*c, depth);
+			depth += 1;
+		}
+	}
+
+	//sort by depth (stable, so siblings keep their order):
+	std::vector< Scene::Transform const * > order;
+	order.reserve(scene.transforms.size());
+	for (auto const &transform : scene.transforms) {
+		order.emplace_back(&transform);
+	}
+	std::stable_sort(order.begin(), order.end(), [&depths](Scene::Transform const *a, Scene::Transform const *b) {
+		return depths.at(a) < depths.at(b);
+	});
+
+	names.clear();
+	parents.clear();
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	local_to_world.clear();
+	levels.clear();
+
+	for (auto t : order) {
+		uint32_t index = uint32_t(names.size());
+		transform_to_index.emplace(t, index);
+		uint32_t depth = depths.at(t);
+		while (levels.size() <= depth) levels.emplace_back(index);
+
+		names.emplace_back(t->name);
+		if (t->parent) {
+			//n.b. parents outside the scene's transform list are not supported:
+			auto f = transform_to_index.find(t->parent);
+			if (f == transform_to_index.end()) throw std::runtime_error("Transform '" + t->name + "' has a parent that isn't in its scene.");
+			parents.emplace_back(f->second);
+		} else {
+			parents.emplace_back(-1U);
+		}
+		positions.emplace_back(t->position);
+		rotations.emplace_back(t->rotation);
+		scales.emplace_back(t->scale);
+	}
+	levels.emplace_back(uint32_t(names.size()));
+
+	auto lookup = [&transform_to_index](Scene::Transform const *t) {
+		auto f = transform_to_index.find(t);
+		if (f == transform_to_index.end()) throw std::runtime_error("Scene object refers to a transform that isn't in its scene.");
+		return f->second;
+	};
+
+	drawables.clear();
+	drawables.reserve(scene.drawables.size());
+	for (auto const &d : scene.drawables) {
+		drawables.emplace_back(Drawable{lookup(d.transform), d.pipeline});
+	}
+
+	cameras.clear();
+	for (auto const &c : scene.cameras) {
+		cameras.emplace_back();
+		cameras.back().transform = lookup(c.transform);
+		cameras.back().fovy = c.fovy;
+		cameras.back().aspect = c.aspect;
+		cameras.back().near = c.near;
+	}
+
+	lights.clear();
+	for (auto const &l : scene.lights) {
+		lights.emplace_back();
+		lights.back().transform = lookup(l.transform);
+		lights.back().type = l.type;
+		lights.back().energy = l.energy;
+		lights.back().spot_fov = l.spot_fov;
+	}
+
+	update_transforms();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+ * FlatScene is a compact, index-based copy of a Scene.
+ *
+ * Transforms are stored as parallel arrays sorted by depth in the hierarchy,
+ * so every transform's parent comes before it, and drawables / cameras / lights
+ * refer to transforms by index rather than by pointer. This means:
+ *  - updating world matrices is a single linear pass over the arrays;
+ *  - copying a FlatScene is a plain copy of its vectors (no pointer fix-up);
+ *  - each hierarchy level only depends on earlier levels, so a level can be
+ *    updated in independent chunks (e.g., on several threads).
+ *
+ * Make one with FlatScene(scene) / set(scene), edit positions / rotations / scales,
+ * call update_transforms(), then draw().
+ *
+ */
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct FlatScene {
+	//transforms (parallel arrays, sorted so that parents[i] < i):
+	std::vector< std::string > names;
+	std::vector< uint32_t > parents; //-1U for no parent
+	std::vector< glm::vec3 > positions;
+	std::vector< glm::quat > rotations;
+	std::vector< glm::vec3 > scales;
+	//computed by update_transforms():
+	std::vector< glm::mat4x3 > local_to_world;
+
+	//transforms [levels[d], levels[d+1]) are at depth d in the hierarchy:
+	std::vector< uint32_t > levels;
+
+	struct Drawable {
+		uint32_t transform;
+		Scene::Drawable::Pipeline pipeline;
+	};
+	std::vector< Drawable > drawables;
+
+	struct Camera {
+		uint32_t transform;
+		//as in Scene::Camera:
+		float fovy = glm::radians(60.0f);
+		float aspect = 1.0f;
+		float near = 0.01f;
+		glm::mat4 make_projection() const;
+	};
+	std::vector< Camera > cameras;
+
+	struct Light {
+		uint32_t transform;
+		//as in Scene::Light:
+		Scene::Light::Type type = Scene::Light::Point;
+		glm::vec3 energy = glm::vec3(1.0f);
+		float spot_fov = glm::radians(45.0f);
+	};
+	std::vector< Light > lights;
+
+	//compute local_to_world for transforms [begin, end):
+	// (their parents must already be up to date -- e.g., update one level at a time)
+	// (local_to_world must already be sized, by set() or update_transforms(), if transforms were added since)
+	void update_transforms(uint32_t begin, uint32_t end);
+	//..for all transforms (also sizes local_to_world):
+	void update_transforms();
+
+	//draw all drawables (using local_to_world as last updated):
+	void draw(Camera const &camera) const;
+	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
+
+	//index of the first transform with a given name, or -1U:
+	uint32_t find(std::string const &name) const;
+
+	//empty scene:
+	FlatScene() = default;
+
+	//flatten a scene:
+	explicit FlatScene(Scene const &scene);
+	//..optionally returning the transform -> index mapping:
+	void set(Scene const &scene, std::unordered_map< Scene::Transform const *, uint32_t > *transform_map = nullptr);
+
+	//internals:
+	//scratch space for draw(), kept between calls so it doesn't need to be re-allocated every frame:
+	mutable std::vector< Scene::DrawItem > draw_list;
+	mutable std::vector< Scene::QueuedItem > draw_queue;
+};
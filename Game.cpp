@@ -1,6 +1,7 @@
 #include "Game.hpp"
 
 #include "Connection.hpp"
+#include "Zobrist.hpp"
 
 #include <stdexcept>
 #include <iostream>
@@ -11,8 +12,7 @@
 #include <glm/gtx/norm.hpp>
 
 #include <array>        // std::array
-#include <random>       // std::default_random_engine
-#include <chrono>       // std::chrono::system_clock
+#include <random>       // std::mt19937
 
 void Player::Controls::send_controls_message(Connection *connection_) const {
 	assert(connection_);
@@ -95,6 +95,60 @@ bool Player::Controls::recv_controls_message(Connection *connection_) {
 	return true;
 }
 
+void Player::Controls::pack(uint8_t *bytes) const {
+	assert(bytes);
+	uint32_t at = 0;
+	auto pack_button = [&](Button const &b) {
+		bytes[at++] = uint8_t( (b.pressed ? 0x80 : 0x00) | (b.downs & 0x7f) );
+	};
+
+	pack_button(left);
+	pack_button(right);
+	pack_button(up);
+	pack_button(down);
+	pack_button(jump);
+	pack_button(oneb);
+	pack_button(twob);
+	pack_button(threeb);
+	pack_button(fourb);
+	pack_button(fiveb);
+	pack_button(sixb);
+	pack_button(sevenb);
+	pack_button(eightb);
+	pack_button(nineb);
+	pack_button(zerob);
+	pack_button(xb);
+	assert(at == PackedSize);
+}
+
+void Player::Controls::unpack(uint8_t const *bytes) {
+	assert(bytes);
+	uint32_t at = 0;
+	auto unpack_button = [&](Button *b) {
+		b->pressed = (bytes[at] & 0x80);
+		b->downs = (bytes[at] & 0x7f);
+		at += 1;
+	};
+
+	unpack_button(&left);
+	unpack_button(&right);
+	unpack_button(&up);
+	unpack_button(&down);
+	unpack_button(&jump);
+	unpack_button(&oneb);
+	unpack_button(&twob);
+	unpack_button(&threeb);
+	unpack_button(&fourb);
+	unpack_button(&fiveb);
+	unpack_button(&sixb);
+	unpack_button(&sevenb);
+	unpack_button(&eightb);
+	unpack_button(&nineb);
+	unpack_button(&zerob);
+	unpack_button(&xb);
+	assert(at == PackedSize);
+}
+
 
 //-----------------------------------------
 
@@ -115,8 +169,8 @@ Player *Game::spawn_player() {
 			pos_pile.push_back(std::make_tuple(i, j, 2, player_num));
 		}
 	}
-	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-	std::shuffle (pos_pile.begin(), pos_pile.end(), std::default_random_engine(seed));
+	//n.b. shuffling with the game's generator makes deals reproducible from its seed (see Replay.hpp):
+	std::shuffle (pos_pile.begin(), pos_pile.end(), mt);
 
 	// Make the neg_pile and allocate 13 cards
 	std::vector<std::tuple<int, int, int, int>> neg_pile;
@@ -162,6 +216,9 @@ Player *Game::spawn_player() {
 	player.score = score;
 	player.pos_pos = 3;
 
+	player.hash = player.compute_hash();
+	hash ^= player.hash;
+
 	return &player;
 }
 
@@ -169,6 +226,7 @@ void Game::remove_player(Player *player) {
 	bool found = false;
 	for (auto pi = players.begin(); pi != players.end(); ++pi) {
 		if (&*pi == player) {
+			hash ^= pi->hash;
 			players.erase(pi);
 			found = true;
 			break;
@@ -177,6 +235,158 @@ void Game::remove_player(Player *player) {
 	assert(found);
 }
 
+uint64_t Game::compute_hash() const {
+	uint64_t h = 0;
+	for (auto const &player : players) {
+		h ^= player.hash;
+	}
+	return h;
+}
+
+//Zobrist key for a card in a pile (only suit and rank matter; selection state doesn't):
+static uint64_t card_key(int pile, size_t index, std::tuple<int, int, int, int> const &card) {
+	return Zobrist::card(pile, uint32_t(index), uint32_t(std::get<0>(card) * 13 + std::get<1>(card)));
+}
+
+uint64_t Player::compute_hash() const {
+	uint64_t h = 0;
+	auto hash_pile = [&h](int pile, std::vector<std::tuple<int, int, int, int>> const &cards) {
+		for (size_t i = 0; i < cards.size(); ++i) {
+			h ^= card_key(pile, i, cards[i]);
+		}
+	};
+	hash_pile(0, pos_pile);
+	hash_pile(1, neg_pile);
+	hash_pile(2, one);
+	hash_pile(3, two);
+	hash_pile(4, three);
+	hash_pile(5, four);
+	h ^= Zobrist::suit(0, std::get<1>(D));
+	h ^= Zobrist::suit(1, std::get<1>(H));
+	h ^= Zobrist::suit(2, std::get<1>(C));
+	h ^= Zobrist::suit(3, std::get<1>(S));
+	h ^= Zobrist::pos_pos(pos_pos);
+	return h;
+}
+
+void Player::flip() {
+	hash ^= Zobrist::pos_pos(pos_pos);
+	pos_pos += 3;
+	if (pos_pos >= pos_pile.size()) {
+		pos_pos = 3;
+	}
+	if (pos_pos >= pos_pile.size()) {
+		pos_pos = pos_pile.size() - 1;
+	}
+	hash ^= Zobrist::pos_pos(pos_pos);
+}
+
+std::vector< std::tuple< int, int, int, int > > *Player::active_pile(int pile) {
+	switch (pile) {
+		case 2: return &one;
+		case 3: return &two;
+		case 4: return &three;
+		case 5: return &four;
+		default: return nullptr;
+	}
+}
+
+std::tuple< int, int, int, int > *Player::suit_pile(int pile) {
+	switch (pile) {
+		case 6: return &D;
+		case 7: return &H;
+		case 8: return &C;
+		case 9: return &S;
+		default: return nullptr;
+	}
+}
+
+std::vector< std::tuple< int, int, int, int > > const *Player::active_pile(int pile) const {
+	switch (pile) {
+		case 2: return &one;
+		case 3: return &two;
+		case 4: return &three;
+		case 5: return &four;
+		default: return nullptr;
+	}
+}
+
+std::tuple< int, int, int, int > const *Player::suit_pile(int pile) const {
+	switch (pile) {
+		case 6: return &D;
+		case 7: return &H;
+		case 8: return &C;
+		case 9: return &S;
+		default: return nullptr;
+	}
+}
+
+bool Player::move_card(int from, int to) {
+	// can be neg_pile, pos_pile, one, two, three, or four
+	std::tuple<int, int, int, int> *from_card;
+	if (from == 0) {
+		from_card = &pos_pile.at(pos_pos);
+	} else if (from == 1) {
+		from_card = &neg_pile.back();
+	} else {
+		from_card = &active_pile(from)->back();
+	}
+	std::tuple<int, int, int, int> move_card = *from_card;
+	std::tuple<int, int, int, int> new_card = std::make_tuple(std::get<0>(move_card), std::get<1>(move_card), 2, std::get<2>(move_card));
+
+	// can be one, two, three, four, D, H, C, or S
+	bool success = false;
+	if (auto *to_pile = active_pile(to)) {
+		// alternating color, decrease by one
+		if (to_pile->size() == 0 || stacks_on_active(std::get<0>(to_pile->back()), std::get<1>(to_pile->back()), std::get<0>(new_card), std::get<1>(new_card))) {
+			success = true;
+			hash ^= card_key(to, to_pile->size(), new_card);
+			to_pile->push_back(new_card);
+		}
+	} else {
+		// same suit, increase by one
+		auto *to_card = suit_pile(to);
+		if (stacks_on_suit(std::get<0>(*to_card), std::get<1>(*to_card), std::get<0>(new_card), std::get<1>(new_card))) {
+			success = true;
+			hash ^= Zobrist::suit(to - 6, std::get<1>(*to_card));
+			hash ^= Zobrist::suit(to - 6, std::get<1>(new_card));
+			*to_card = new_card;
+			score++;
+		}
+	}
+
+	if (success) {
+		// remove
+		if (from == 0) {
+			//cards above the removed one shift down, so their keys change:
+			for (size_t i = pos_pos; i < pos_pile.size(); ++i) {
+				hash ^= card_key(0, i, pos_pile[i]);
+			}
+			pos_pile.erase(pos_pile.begin()+pos_pos);
+			for (size_t i = pos_pos; i < pos_pile.size(); ++i) {
+				hash ^= card_key(0, i, pos_pile[i]);
+			}
+			if (pos_pos != 0) {
+				hash ^= Zobrist::pos_pos(pos_pos);
+				pos_pos--;
+				hash ^= Zobrist::pos_pos(pos_pos);
+			}
+		} else if (from == 1) {
+			hash ^= card_key(1, neg_pile.size() - 1, neg_pile.back());
+			neg_pile.pop_back();
+		} else {
+			auto *from_pile = active_pile(from);
+			hash ^= card_key(from, from_pile->size() - 1, from_pile->back());
+			from_pile->pop_back();
+		}
+	} else {
+		// fix coloring
+		*from_card = new_card;
+	}
+
+	return success;
+}
+
 void Game::update(float elapsed) {
 
 	bool done = false;
@@ -193,13 +403,9 @@ void Game::update(float elapsed) {
 	for (auto &p : players) {
 		// controls the current top of the pos_pile
 		if (p.controls.jump.pressed) {
-			p.pos_pos += 3;
-			if (p.pos_pos >= p.pos_pile.size()) {
-				p.pos_pos = 3;
-			}
-			if (p.pos_pos >= p.pos_pile.size()) {
-				p.pos_pos = p.pos_pile.size() - 1;
-			}
+			hash ^= p.hash;
+			p.flip();
+			hash ^= p.hash;
 		}
 
 		// controls the neg_pile -- can move from not to
@@ -236,7 +442,7 @@ void Game::update(float elapsed) {
 				p.first = 3;
 				std::tuple<int, int, int, int> temp = p.two.back();
 				p.two.back() = std::make_tuple(std::get<0>(temp), std::get<1>(temp), 0, std::get<3>(temp));
-			} else if (p.second == -1 && p.first != 2) {
+			} else if (p.second == -1 && p.first != 3) {
 				p.second = 3;
 			} else if (p.first == 3) {
 				p.first = -1;
@@ -317,154 +523,9 @@ void Game::update(float elapsed) {
 		}
 
 		if (p.first >= 0 && p.second >= 0) {
-			bool success = false;
-			std::tuple<int, int, int, int> move_card;
-			switch (p.first) {
-				// can be neg_pile, pos_pile, one, two, three, or four
-				case 0: // pos_pile
-					move_card = p.pos_pile.at(p.pos_pos);
-					break;
-				case 1: // neg_pile
-					move_card = p.neg_pile.back();
-					break;
-				case 2: // one
-					move_card = p.one.back();
-					break;
-				case 3: // two
-					move_card = p.two.back();
-					break;
-				case 4: // three
-					move_card = p.three.back();
-					break;
-				default: // four
-					move_card = p.four.back();
-					break;
-			}
-
-			std::tuple<int, int, int, int> new_card = std::make_tuple(std::get<0>(move_card), std::get<1>(move_card), 2, std::get<2>(move_card));
-			
-			// can be one, two, three, four, D, H, C, or S
-			switch (p.second) {
-				// next four: alternating color, decrease by one
-				case 2:
-					if (p.one.size() == 0) {
-						success = true;
-						p.one.push_back(new_card);
-					} else if (((std::get<0>(p.one.back()) < 2 && std::get<0>(new_card) >= 2) || (std::get<0>(p.one.back()) >= 2 && std::get<0>(new_card) < 2)) && (std::get<1>(p.one.back()) == std::get<1>(new_card) + 1)) {
-						success = true;
-						p.one.push_back(new_card);
-					}
-					break;
-				case 3:
-					if (p.two.size() == 0) {
-						success = true;
-						p.two.push_back(new_card);
-					} else if (((std::get<0>(p.two.back()) < 2 && std::get<0>(new_card) >= 2) || (std::get<0>(p.two.back()) >= 2 && std::get<0>(new_card) < 2)) && (std::get<1>(p.two.back()) == std::get<1>(new_card) + 1)) {
-						success = true;
-						p.two.push_back(new_card);
-					}
-					break;
-				case 4:
-					if (p.three.size() == 0) {
-						success = true;
-						p.three.push_back(new_card);
-					} else if (((std::get<0>(p.three.back()) < 2 && std::get<0>(new_card) >= 2) || (std::get<0>(p.three.back()) >= 2 && std::get<0>(new_card) < 2)) && (std::get<1>(p.three.back()) == std::get<1>(new_card) + 1)) {
-						success = true;
-						p.three.push_back(new_card);
-					}
-					break;
-				case 5:
-					if (p.four.size() == 0) {
-						success = true;
-						p.four.push_back(new_card);
-					} else if (((std::get<0>(p.four.back()) < 2 && std::get<0>(new_card) >= 2) || (std::get<0>(p.four.back()) >= 2 && std::get<0>(new_card) < 2)) && (std::get<1>(p.four.back()) == std::get<1>(new_card) + 1)) {
-						success = true;
-						p.four.push_back(new_card);
-					}
-					break;
-				
-				// next four: same suit, increase by one
-				case 6:
-					if (std::get<0>(new_card) == std::get<0>(p.D) && std::get<1>(new_card) == std::get<1>(p.D) + 1) {
-						success = true;
-						p.D = new_card;
-						p.score++;
-					}
-					break;
-				case 7:
-					if (std::get<0>(new_card) == std::get<0>(p.H) && std::get<1>(new_card) == std::get<1>(p.H) + 1) {
-						success = true;
-						p.H = new_card;
-						p.score++;
-					}
-					break;
-				case 8:
-					if (std::get<0>(new_card) == std::get<0>(p.C) && std::get<1>(new_card) == std::get<1>(p.C) + 1) {
-						success = true;
-						p.C = new_card;
-						p.score++;
-					} 
-					break;
-				default:
-					if (std::get<0>(new_card) == std::get<0>(p.S) && std::get<1>(new_card) == std::get<1>(p.S) + 1) {
-						success = true;
-						p.S = new_card;
-						p.score++;
-					} 
-					break;
-			}
-
-			// need to remove
-			if (success) {
-				// remove
-				switch (p.first) {
-					// can be neg_pile, pos_pile, one, two, three, or four
-					case 0: // pos_pile
-						p.pos_pile.erase(p.pos_pile.begin()+p.pos_pos);
-						if (p.pos_pos != 0) {
-							p.pos_pos--;
-						}
-						break;
-					case 1: // neg_pile
-						p.neg_pile.pop_back();
-						break;
-					case 2: // one
-						p.one.pop_back();
-						break;
-					case 3: // two
-						p.two.pop_back();
-						break;
-					case 4: // three
-						p.three.pop_back();
-						break;
-					default: // four
-						p.four.pop_back();
-						break;
-				}
-			} else {
-				// fix coloring
-				switch (p.first) {
-					// can be neg_pile, pos_pile, one, two, three, or four
-					case 0: // pos_pile
-						p.pos_pile.at(p.pos_pos) = new_card;
-						break;
-					case 1: // neg_pile
-						p.neg_pile.back() = new_card;
-						break;
-					case 2: // one
-						p.one.back() = new_card;
-						break;
-					case 3: // two
-						p.two.back() = new_card;
-						break;
-					case 4: // three
-						p.three.back() = new_card;
-						break;
-					default: // four
-						p.four.back() = new_card;
-						break;
-				}
-			}
+			hash ^= p.hash;
+			p.move_card(p.first, p.second);
+			hash ^= p.hash;
 
 			if (p.neg_pile.size() == 0) {
 				p.done = true;
@@ -573,6 +634,9 @@ void Game::send_state_message(Connection *connection_, Player *connection_player
 		send_player(player);
 	}
 
+	//lets the client check that it ended up with the same state:
+	connection.send(hash);
+
 	//compute the message size and patch into the message header:
 	uint32_t size = uint32_t(connection.send_buffer.size() - mark);
 	connection.send_buffer[mark-3] = uint8_t(size);
@@ -689,10 +753,21 @@ bool Game::recv_state_message(Connection *connection_) {
 		read(&player.score);
 		read(&player.pos_pos);
 		read(&player.done);
+
+		player.hash = player.compute_hash();
+	}
+
+	uint64_t sent_hash;
+	read(&sent_hash);
+	hash = compute_hash();
+	if (hash != sent_hash) {
+		std::cerr << "WARNING: state hash mismatch (got " << std::hex << sent_hash << ", computed " << hash << std::dec << ")." << std::endl;
 	}
 
 	if (at != size) throw std::runtime_error("Trailing data in state message.");
 
+	state_version += 1;
+
 	//delete message from buffer:
 	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
 
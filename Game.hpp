@@ -4,6 +4,7 @@
 
 #include <string>
 #include <list>
+#include <tuple>
 #include <random>
 #include <vector>
 #include <utility>
@@ -38,6 +39,13 @@ struct Player {
 		//returns 'true' if read a controls message,
 		//throws on malformed controls message
 		bool recv_controls_message(Connection *connection);
+
+		//button state packed one byte per button, as in a controls message:
+		// (pressed in the high bit, downs in the low seven bits)
+		static constexpr uint32_t PackedSize = 16;
+		void pack(uint8_t *bytes) const;
+		//replaces (rather than accumulates, like recv_controls_message) the button state:
+		void unpack(uint8_t const *bytes);
 	} controls;
 
 	// neg pile -- starts at 13 cards, game ends when gets to 0
@@ -69,20 +77,53 @@ struct Player {
 	glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
 	std::string name = "";
 
+	//piles are numbered as selected by the number keys:
+	// 0: pos_pile, 1: neg_pile, 2-5: one-four, 6-9: D, H, C, S
 	int first = -1;
 	int second = -1;
 
 	bool done = false;
+
+	//move the top card of pile 'from' (0-5) onto pile 'to' (2-9), if the rules allow:
+	// (returns 'false' and leaves the piles alone otherwise)
+	bool move_card(int from, int to);
+	//advance pos_pos to the next three cards of pos_pile:
+	void flip();
+
+	//Zobrist hash of the piles (see Zobrist.hpp); kept up to date by move_card, flip, and Game::spawn_player:
+	uint64_t hash = 0;
+	//recompute the hash from scratch:
+	uint64_t compute_hash() const;
+
+	//helpers to get piles by number (nullptr if not an active / suit pile number):
+	std::vector<std::tuple<int, int, int, int>> *active_pile(int pile);
+	std::tuple<int, int, int, int> *suit_pile(int pile);
+	std::vector<std::tuple<int, int, int, int>> const *active_pile(int pile) const;
+	std::tuple<int, int, int, int> const *suit_pile(int pile) const;
 };
 
+//card rules (suits 0 and 1 are red, 2 and 3 are black; ranks run 0 (A) to 12 (K)):
+// active piles build down by one in alternating colors:
+inline bool stacks_on_active(int top_suit, int top_rank, int suit, int rank) {
+	return ((top_suit < 2) != (suit < 2)) && top_rank == rank + 1;
+}
+// suit piles build up by one within a suit (empty suit piles have rank -1):
+inline bool stacks_on_suit(int top_suit, int top_rank, int suit, int rank) {
+	return top_suit == suit && top_rank + 1 == rank;
+}
+
 struct Game {
 	std::list< Player > players; //(using list so they can have stable addresses)
 	Player *spawn_player(); //add player the end of the players list (may also, e.g., play some spawn anim)
 	void remove_player(Player *); //remove player from game (may also, e.g., play some despawn anim)
 
-	std::mt19937 mt; //used for spawning players
+	std::mt19937 mt; //used for spawning players (and shuffling their decks)
 	uint32_t next_player_number = 1; //used for naming players
 
+	//XOR of all players' hashes (order-independent, so it matches on client and server):
+	uint64_t hash = 0;
+	uint64_t compute_hash() const;
+
 	Game();
 
 	//state update function:
@@ -112,6 +153,8 @@ struct Game {
 	//set game state from data in connection buffer
 	// (return true if data was read)
 	bool recv_state_message(Connection *connection);
+	//incremented every time recv_state_message reads a message (so views can tell when to re-layout):
+	uint32_t state_version = 0;
 
 	//used by server:
 	//send game state.
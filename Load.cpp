@@ -1,20 +1,55 @@
 #include "Load.hpp"
 
+#include <algorithm>
 #include <array>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <cassert>
 
 namespace {
-	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
-		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
+	struct LoadFunction {
+		void const *name;
+		std::function< void() > fn;
+	};
+	std::array< std::list< LoadFunction >, MaxLoadTag > &get_load_lists() {
+		static std::array< std::list< LoadFunction >, MaxLoadTag > load_lists;
 		return load_lists;
 	}
+
+	struct Job {
+		void const *name = nullptr;
+		LoadAfter after;
+		std::function< void() > work; //on a loading thread
+		std::function< void() > upload; //on the OpenGL thread
+		//set up by call_load_functions:
+		uint32_t waiting = 0; //jobs this job waits for that haven't finished
+		std::vector< Job * > then; //jobs that wait for this job
+		std::exception_ptr error; //thrown by 'work'
+	};
+	std::list< Job > &get_jobs() { //(list, since jobs point at each other)
+		static std::list< Job > jobs;
+		return jobs;
+	}
 }
 
-void add_load_function(LoadTag tag, std::function< void() > const &fn) {
+void add_load_function(LoadTag tag, std::function< void() > const &fn, void const *name) {
 	auto &load_lists = get_load_lists();
 	assert(tag < load_lists.size());
-	load_lists[tag].emplace_back(fn);
+	load_lists[tag].emplace_back(LoadFunction{name, fn});
+}
+
+void add_load_job(void const *name, LoadAfter const &after, std::function< void() > const &work, std::function< void() > const &upload) {
+	auto &jobs = get_jobs();
+	jobs.emplace_back();
+	jobs.back().name = name;
+	jobs.back().after = after;
+	jobs.back().work = work;
+	jobs.back().upload = upload;
 }
 
 void call_load_functions() {
@@ -22,11 +57,141 @@ void call_load_functions() {
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
 
-	auto &load_lists = get_load_lists();
-	for (auto &fn_list : load_lists) {
-		while (!fn_list.empty()) {
-			(*fn_list.begin())(); //call first function in the list
-			fn_list.pop_front(); //remove from list
+	auto &jobs = get_jobs();
+
+	auto link = [](Job *first, Job *second) {
+		first->then.emplace_back(second);
+		second->waiting += 1;
+	};
+
+	//tagged functions become upload-only jobs, each waiting for the one before (which keeps the old ordering):
+	Job *previous = nullptr;
+	for (auto &fn_list : get_load_lists()) {
+		for (auto &fn : fn_list) {
+			jobs.emplace_back();
+			jobs.back().name = fn.name;
+			jobs.back().upload = std::move(fn.fn);
+			if (previous) link(previous, &jobs.back());
+			previous = &jobs.back();
+		}
+		fn_list.clear();
+	}
+
+	//resolve 'after' names:
+	std::unordered_map< void const *, Job * > named;
+	for (auto &job : jobs) {
+		if (job.name) named.emplace(job.name, &job);
+	}
+	for (auto &job : jobs) {
+		for (void const *name : job.after) {
+			auto f = named.find(name);
+			if (f == named.end()) {
+				throw std::runtime_error("Load job waits for a Load<> that was never added.");
+			}
+			link(f->second, &job);
+		}
+	}
+
+	//---- run jobs ----
+	//work goes to a pool of loading threads; uploads (and jobs with no work) come back to this thread.
+
+	std::mutex mutex;
+	std::condition_variable work_ready; //loading threads wait on this
+	std::condition_variable upload_ready; //this thread waits on this
+	std::deque< Job * > work_queue;
+	std::deque< Job * > upload_queue;
+	uint32_t working = 0; //jobs in work_queue or being worked on
+	bool quit = false;
+
+	//(call with mutex held)
+	auto start = [&](Job *job) {
+		if (job->work) {
+			work_queue.emplace_back(job);
+			working += 1;
+			work_ready.notify_one();
+		} else {
+			upload_queue.emplace_back(job);
+		}
+	};
+
+	uint32_t work_count = 0;
+	for (auto &job : jobs) {
+		if (job.work) work_count += 1;
+		if (job.waiting == 0) start(&job);
+	}
+
+	auto loader = [&]() {
+		std::unique_lock< std::mutex > lock(mutex);
+		while (true) {
+			work_ready.wait(lock, [&](){ return quit || !work_queue.empty(); });
+			if (quit) return;
+			Job *job = work_queue.front();
+			work_queue.pop_front();
+
+			lock.unlock();
+			try {
+				job->work();
+			} catch (...) {
+				job->error = std::current_exception();
+			}
+			lock.lock();
+
+			working -= 1;
+			upload_queue.emplace_back(job);
+			upload_ready.notify_one();
+		}
+	};
+
+	//one loading thread per core, leaving one core for this thread:
+	uint32_t cores = std::thread::hardware_concurrency();
+	uint32_t thread_count = std::min(work_count, (cores > 2 ? cores - 1 : 1));
+
+	//stops and joins loading threads, even if an upload throws:
+	struct Loaders {
+		std::mutex &mutex;
+		std::condition_variable &work_ready;
+		bool &quit;
+		std::vector< std::thread > threads;
+		~Loaders() {
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				quit = true;
+			}
+			work_ready.notify_all();
+			for (auto &thread : threads) {
+				thread.join();
+			}
+		}
+	} loaders{mutex, work_ready, quit, {}};
+	for (uint32_t t = 0; t < thread_count; ++t) {
+		loaders.threads.emplace_back(loader);
+	}
+
+	for (size_t finished = 0; finished < jobs.size(); ++finished) {
+		Job *job;
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			if (upload_queue.empty() && working == 0) {
+				throw std::runtime_error("Load jobs wait for each other in a cycle.");
+			}
+			upload_ready.wait(lock, [&](){ return !upload_queue.empty(); });
+			job = upload_queue.front();
+			upload_queue.pop_front();
+		}
+
+		if (job->error) std::rethrow_exception(job->error);
+		if (job->upload) job->upload();
+
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			for (Job *next : job->then) {
+				assert(next->waiting > 0);
+				next->waiting -= 1;
+				if (next->waiting == 0) start(next);
+			}
 		}
 	}
+
+	//(don't hang on to load closures or anything they captured)
+	jobs.clear();
 }
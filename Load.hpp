@@ -20,10 +20,25 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * Loads can instead be split into 'work' (file reads, decoding, ... anything but OpenGL)
+ * that runs on a pool of loading threads, and an 'upload' that runs on the OpenGL thread.
+ * These say exactly what they wait for, instead of using tags, so independent loads run in parallel:
+ *
+ * Load< MeshBuffer > main_meshes(LoadAfter{}, []() -> MeshBuffer * {
+ *     return new MeshBuffer(data_path("main.pnct"), MeshBuffer::UploadLater); //runs on a loading thread
+ * }, [](MeshBuffer &buffer) {
+ *     buffer.upload(); //runs on the OpenGL thread
+ * });
+ * Load< GLuint > main_vao(LoadAfter{ &main_meshes, &lit_color_texture_program }, nullptr, [](GLuint &vao) {
+ *     vao = main_meshes->make_vao_for_program(lit_color_texture_program->program);
+ * });
+ *
  */
 
 #include <functional>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
 enum LoadTag : uint32_t {
 	LoadTagEarly,
@@ -34,10 +49,24 @@ enum LoadTag : uint32_t {
 
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
-void add_load_function(LoadTag tag, std::function< void() > const &fn);
+// (functions run on the OpenGL thread, in tag order, then in the order they were added)
+// 'name' lets jobs (below) wait for this function; Load<> uses its own address.
+void add_load_function(LoadTag tag, std::function< void() > const &fn, void const *name = nullptr);
+
+//Loads are named by the address of their Load<> object (e.g. '&card_program').
+// (the address of a global is fine to use before it is constructed, so this works across files)
+// n.b. write 'LoadAfter{ ... }' -- a bare '{}' would pick the tag version of Load<>'s constructor.
+typedef std::vector< void const * > LoadAfter;
+
+//Add a loading job:
+// (only call *before* "call_load_functions()")
+// 'work' (if not empty) runs on a loading thread, so must not call OpenGL or touch data other loads might be using;
+// 'upload' (if not empty) then runs on the OpenGL thread.
+// The job starts once everything in 'after' has finished (both work and upload).
+void add_load_job(void const *name, LoadAfter const &after, std::function< void() > const &work, std::function< void() > const &upload);
 
-//Call all loading functions:
-// (loading functions may throw exceptions if they fail.)
+//Call all loading functions and run all loading jobs:
+// (loading functions may throw exceptions if they fail; exceptions from work functions are re-thrown here.)
 // (only call *once*)
 void call_load_functions();
 
@@ -55,6 +84,26 @@ struct Load {
 			if (!(this->value)) {
 				throw std::runtime_error("Loading failed.");
 			}
+		}, this);
+	}
+
+	//Or construct with a job that makes the T on a loading thread (an empty 'work_fn' means 'new T' on the OpenGL thread)
+	// and then finishes it on the OpenGL thread; 'value' is set once 'upload_fn' is done:
+	Load(LoadAfter const &after, const std::function< T *() > &work_fn, const std::function< void(T &) > &upload_fn = nullptr) : value(nullptr) {
+		std::shared_ptr< T * > loaded = std::make_shared< T * >(nullptr); //handed from work to upload
+		std::function< void() > work;
+		if (work_fn) {
+			work = [loaded,work_fn](){
+				*loaded = work_fn();
+				if (!*loaded) {
+					throw std::runtime_error("Loading failed.");
+				}
+			};
+		}
+		add_load_job(this, after, work, [this,loaded,upload_fn](){
+			if (!*loaded) *loaded = new T;
+			if (upload_fn) upload_fn(**loaded);
+			this->value = *loaded;
 		});
 	}
 
@@ -74,7 +123,11 @@ template< >
 struct Load< void > {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
 	Load( LoadTag tag, const std::function< void() > &load_fn) {
-		add_load_function(tag, load_fn);
+		add_load_function(tag, load_fn, this);
+	}
+	//...or runs 'work_fn' on a loading thread, then 'upload_fn' on the OpenGL thread:
+	Load( LoadAfter const &after, const std::function< void() > &work_fn, const std::function< void() > &upload_fn = nullptr) {
+		add_load_job(this, after, work_fn, upload_fn);
 	}
 };
 
@@ -0,0 +1,92 @@
+#include "MappedFile.hpp"
+
+//--------- OS-specific mapping-related headers ---------
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#include <windows.h>
+#undef max
+#undef min
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include <stdexcept>
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const &filename) {
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "' (error " + std::to_string(GetLastError()) + ").");
+	}
+	file = handle;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(handle, &file_size)) {
+		CloseHandle(handle);
+		throw std::runtime_error("Failed to get size of '" + filename + "' (error " + std::to_string(GetLastError()) + ").");
+	}
+	size = size_t(file_size.QuadPart);
+	if (size == 0) return; //(can't map an empty file)
+
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(handle);
+		throw std::runtime_error("Failed to map '" + filename + "' (error " + std::to_string(GetLastError()) + ").");
+	}
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		throw std::runtime_error("Failed to map view of '" + filename + "' (error " + std::to_string(GetLastError()) + ").");
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(std::string const &filename) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw std::runtime_error("Failed to open '" + filename + "': " + std::strerror(errno));
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		int err = errno;
+		close(fd);
+		throw std::runtime_error("Failed to stat '" + filename + "': " + std::strerror(err));
+	}
+	size = size_t(info.st_size);
+
+	if (size != 0) { //(can't map an empty file)
+		void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			int err = errno;
+			close(fd);
+			throw std::runtime_error("Failed to map '" + filename + "': " + std::strerror(err));
+		}
+		data = mapped;
+	}
+
+	//(the mapping keeps the file open)
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (data) munmap(const_cast< void * >(data), size);
+}
+
+#endif
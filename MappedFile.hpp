@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+ * MappedFile maps a whole file into memory (read-only), so loaders can use
+ * its contents in place instead of reading them into buffers.
+ * (see ChunkReader in read_write_chunk.hpp)
+ *
+ * The mapping stays valid until the MappedFile is destroyed.
+ */
+
+#include <string>
+#include <cstddef>
+
+struct MappedFile {
+	//map 'filename'; throws on error:
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	void const *data = nullptr; //start of file contents (page-aligned; nullptr if the file is empty)
+	size_t size = 0; //in bytes
+
+	//internals:
+#ifdef _WIN32
+	void *file = nullptr; //HANDLEs
+	void *mapping = nullptr;
+#endif
+};
@@ -1,54 +1,225 @@
 #include "Mesh.hpp"
 #include "read_write_chunk.hpp"
+#include "MappedFile.hpp"
 
 #include <glm/glm.hpp>
 
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <set>
 #include <cstddef>
+#include <memory>
+#include <algorithm>
+#include <iterator>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
+#include <zlib.h>
 
-	std::ifstream file(filename, std::ios::binary);
+//vertex format of '.pnct' files (and bundles):
+struct PnctVertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(PnctVertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
 
-	GLuint total = 0;
+//vertex format of '.ipnct' files (see Mesh.hpp):
+struct QuantizedVertex {
+	glm::u16vec3 Position; //normalized over mesh bounds
+	uint16_t padding;
+	glm::i8vec4 Normal; //oct-encoded in xy; zw are zero
+	glm::u8vec4 Color;
+	glm::u16vec2 TexCoord; //half floats
+};
+static_assert(sizeof(QuantizedVertex) == 3*2+2+4*1+4*1+2*2, "QuantizedVertex is packed.");
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
-
-	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+static bool ends_with(std::string const &str, std::string const &suffix) {
+	return str.size() >= suffix.size() && str.substr(str.size() - suffix.size()) == suffix;
+}
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+MeshBuffer::MeshBuffer(std::string const &filename, Upload when, size_t budget) {
+	//chunks are used in place, straight out of the file mapping:
+	std::unique_ptr< MappedFile > file(new MappedFile(filename));
+	ChunkReader reader(file->data, file->size);
 
-		total = GLuint(data.size()); //store total for later checks on index
+	if (ends_with(filename, ".ipnct")) {
+		typedef QuantizedVertex Vertex;
 
 		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
+		Position = Attrib(3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Position));
+		Normal = Attrib(4, GL_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Normal));
 		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
-	} else {
+		TexCoord = Attrib(2, GL_HALF_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+
+		ChunkSpan< Vertex > data = reader.read_chunk< Vertex >("qvtx");
+		//(the first chunk is 8 bytes into a page-aligned mapping, so it never needs copying)
+		assert(reinterpret_cast< char const * >(data.data) == reinterpret_cast< char const * >(file->data) + 8);
+
+		//indices are relative to each mesh's first vertex; they are 32-bit only if some mesh needs it:
+		GLenum index_type;
+		size_t index_size;
+		size_t index_count;
+		void const *indices;
+		if (reader.peek_magic() == "ix32") {
+			ChunkSpan< uint32_t > span = reader.read_chunk< uint32_t >("ix32");
+			index_type = GL_UNSIGNED_INT;
+			index_size = 4;
+			index_count = span.size();
+			indices = span.data;
+		} else {
+			ChunkSpan< uint16_t > span = reader.read_chunk< uint16_t >("ix16");
+			index_type = GL_UNSIGNED_SHORT;
+			index_size = 2;
+			index_count = span.size();
+			indices = span.data;
+		}
+
+		ChunkSpan< char > strings = reader.read_chunk< char >("str0");
+
+		struct IndexEntry {
+			uint32_t name_begin, name_end;
+			uint32_t vertex_begin, vertex_end;
+			uint32_t index_begin, index_end;
+			glm::vec3 min, max; //bounding box (which is also the range of quantized positions)
+		};
+		static_assert(sizeof(IndexEntry) == 48, "Index entry should be packed");
+
+		ChunkSpan< IndexEntry > index = reader.read_chunk< IndexEntry >("idx1");
+
+		for (auto const &entry : index) {
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+				throw std::runtime_error("index entry has out-of-range name begin/end");
+			}
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= data.size())) {
+				throw std::runtime_error("index entry has out-of-range vertex begin/end");
+			}
+			if (!(entry.index_begin <= entry.index_end && entry.index_end <= index_count)) {
+				throw std::runtime_error("index entry has out-of-range index begin/end");
+			}
+			//(out-of-range indices would read outside the buffer, so check them here, once)
+			uint32_t vertex_count = entry.vertex_end - entry.vertex_begin;
+			for (uint32_t i = entry.index_begin; i < entry.index_end; ++i) {
+				uint32_t v = (index_type == GL_UNSIGNED_INT
+					? reinterpret_cast< uint32_t const * >(indices)[i]
+					: reinterpret_cast< uint16_t const * >(indices)[i]);
+				if (v >= vertex_count) {
+					throw std::runtime_error("index entry has out-of-range index");
+				}
+			}
+			Mesh mesh;
+			mesh.type = GL_TRIANGLES;
+			mesh.start = entry.index_begin;
+			mesh.count = entry.index_end - entry.index_begin;
+			mesh.index_type = index_type;
+			mesh.base_vertex = GLint(entry.vertex_begin);
+			mesh.position_scale = entry.max - entry.min;
+			mesh.position_offset = entry.min;
+			mesh.min = entry.min;
+			mesh.max = entry.max;
+			add_mesh(filename, std::string_view(strings.begin() + entry.name_begin, entry.name_end - entry.name_begin), mesh);
+		}
+
+		if (!reader.at_end()) {
+			std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+		}
+
+		//vertex and index data are uploaded directly from the mapping, so keep it mapped until then:
+		pending_file = std::move(file);
+		pending_data = data.data;
+		pending_size = data.size() * sizeof(Vertex);
+		pending_indices = indices;
+		pending_indices_size = index_count * index_size;
+		if (when == UploadNow) upload();
+		return;
+	}
+
+	typedef PnctVertex Vertex;
+
+	//store attrib locations:
+	Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
+	Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
+	Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
+	TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+
+	if (ends_with(filename, ".bundle")) {
+		bundle_toc = reader.read_chunk< BundleEntry >("toc0");
+		//(the first chunk is 8 bytes into a page-aligned mapping, so it never needs copying)
+		assert(reinterpret_cast< char const * >(bundle_toc.data) == reinterpret_cast< char const * >(file->data) + 8);
+		bundle_names = reader.read_chunk< char >("str0");
+		bundle_data = reader.read_chunk< uint8_t >("dat0");
+		if (!reader.at_end()) {
+			std::cerr << "WARNING: trailing data in mesh bundle '" << filename << "'" << std::endl;
+		}
+
+		uint32_t slots = uint32_t(bundle_toc.size());
+		if (slots == 0 || (slots & (slots - 1)) != 0) {
+			throw std::runtime_error("mesh bundle '" + filename + "' has a table of contents that isn't a power of two in size");
+		}
+
+		//check entries up front, so lookup() can trust them:
+		uint64_t total = 0;
+		uint32_t largest = 0;
+		std::vector< NameHash > hashes;
+		residency.resize(slots);
+		for (uint32_t slot = 0; slot < slots; ++slot) {
+			BundleEntry const &entry = bundle_toc[slot];
+			if (entry.hash == 0) continue;
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= bundle_names.size())) {
+				throw std::runtime_error("mesh bundle '" + filename + "' has an entry with out-of-range name begin/end");
+			}
+			if (entry.hash != hash_name(std::string_view(bundle_names.begin() + entry.name_begin, entry.name_end - entry.name_begin))) {
+				throw std::runtime_error("mesh bundle '" + filename + "' has an entry with the wrong hash");
+			}
+			hashes.emplace_back(entry.hash);
+			if (!(entry.data_begin <= entry.data_end && entry.data_end <= bundle_data.size())) {
+				throw std::runtime_error("mesh bundle '" + filename + "' has an entry with out-of-range data begin/end");
+			}
+			if (entry.compression == BundleRaw) {
+				if (entry.data_end - entry.data_begin != entry.vertex_count * sizeof(Vertex)) {
+					throw std::runtime_error("mesh bundle '" + filename + "' has an entry with the wrong amount of data");
+				}
+			} else if (entry.compression != BundleZlib) {
+				throw std::runtime_error("mesh bundle '" + filename + "' has an entry with unknown compression " + std::to_string(entry.compression));
+			}
+			Mesh &mesh = residency[slot].mesh;
+			mesh.type = GL_TRIANGLES;
+			mesh.count = entry.vertex_count;
+			mesh.min = entry.min;
+			mesh.max = entry.max;
+			total += entry.vertex_count;
+			largest = std::max(largest, entry.vertex_count);
+		}
+
+		//(lookup by hash relies on hashes being unique)
+		std::sort(hashes.begin(), hashes.end());
+		if (std::adjacent_find(hashes.begin(), hashes.end()) != hashes.end()) {
+			throw std::runtime_error("mesh bundle '" + filename + "' has meshes with the same name hash");
+		}
+
+		capacity = GLuint(std::min< uint64_t >(total, (budget ? budget / sizeof(Vertex) : total)));
+		if (capacity < largest) {
+			throw std::runtime_error("mesh bundle '" + filename + "' has a mesh bigger than the " + std::to_string(budget) + " byte budget");
+		}
+
+		bundle_file = std::move(file);
+		if (when == UploadNow) upload();
+		return;
+	}
+
+	if (!ends_with(filename, ".pnct")) {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	//read data chunk:
+	ChunkSpan< Vertex > data = reader.read_chunk< Vertex >("pnct");
+	//(the first chunk is 8 bytes into a page-aligned mapping, so it never needs copying)
+	assert(reinterpret_cast< char const * >(data.data) == reinterpret_cast< char const * >(file->data) + 8);
+
+	GLuint total = GLuint(data.size()); //store total for later checks on index
+
+	ChunkSpan< char > strings = reader.read_chunk< char >("str0");
 
 	{ //read index chunk, add to meshes:
 		struct IndexEntry {
@@ -57,8 +228,7 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		};
 		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		ChunkSpan< IndexEntry > index = reader.read_chunk< IndexEntry >("idx0");
 
 		for (auto const &entry : index) {
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
@@ -67,7 +237,6 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
 			Mesh mesh;
 			mesh.type = GL_TRIANGLES;
 			mesh.start = entry.vertex_begin;
@@ -76,34 +245,232 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 				mesh.min = glm::min(mesh.min, data[v].Position);
 				mesh.max = glm::max(mesh.max, data[v].Position);
 			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
-			}
+			add_mesh(filename, std::string_view(strings.begin() + entry.name_begin, entry.name_end - entry.name_begin), mesh);
 		}
 	}
 
-	if (file.peek() != EOF) {
+	if (!reader.at_end()) {
 		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
 
+	(void)budget; //(only for bundles)
+
+	//vertex data is uploaded directly from the mapping, so keep it mapped until then:
+	pending_file = std::move(file);
+	pending_data = data.data;
+	pending_size = data.size() * sizeof(Vertex);
+	if (when == UploadNow) upload();
+
 	/* //DEBUG:
 	std::cout << "File '" << filename << "' contained meshes";
-	for (auto const &m : meshes) {
-		if (&m.second == &meshes.rbegin()->second && meshes.size() > 1) std::cout << " and";
-		std::cout << " '" << m.first << "'";
-		if (&m.second != &meshes.rbegin()->second) std::cout << ",";
+	for (auto const &name : mesh_names) {
+		if (&name == &mesh_names.back() && mesh_names.size() > 1) std::cout << " and";
+		std::cout << " '" << name << "'";
+		if (&name != &mesh_names.back()) std::cout << ",";
 	}
 	std::cout << std::endl;
 	*/
 }
 
-const Mesh &MeshBuffer::lookup(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
-		throw std::runtime_error("Looking up mesh '" + name + "' that doesn't exist.");
+void MeshBuffer::upload() {
+	if (buffer == 0) glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (bundle_file) {
+		//bundle meshes are uploaded by lookup(), so just make room:
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(PnctVertex), nullptr, GL_STATIC_DRAW);
+		free_vertices.clear();
+		if (capacity) free_vertices.emplace(0, capacity);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, pending_size, pending_data, GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (pending_indices) {
+		if (index_buffer == 0) glGenBuffers(1, &index_buffer);
+		//(bound to GL_ARRAY_BUFFER, since binding GL_ELEMENT_ARRAY_BUFFER would change whatever vertex array is bound)
+		glBindBuffer(GL_ARRAY_BUFFER, index_buffer);
+		glBufferData(GL_ARRAY_BUFFER, pending_indices_size, pending_indices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	//(unmap file)
+	pending_file.reset();
+	pending_data = nullptr;
+	pending_size = 0;
+	pending_indices = nullptr;
+	pending_indices_size = 0;
+}
+
+void MeshBuffer::add_mesh(std::string const &filename, std::string_view name, Mesh const &mesh) {
+	NameHash hash = hash_name(name);
+	uint32_t existing = find_mesh(hash);
+	if (existing != -1U) {
+		if (mesh_names[existing] == name) {
+			std::cerr << "WARNING: mesh name '" << name << "' in filename '" << filename << "' collides with existing mesh." << std::endl;
+			return;
+		}
+		throw std::runtime_error("Mesh names '" + mesh_names[existing] + "' and '" + std::string(name) + "' in '" + filename + "' have the same hash; please rename one.");
+	}
+
+	meshes.emplace_back(mesh);
+	mesh_names.emplace_back(name);
+
+	auto insert = [this](NameHash h, uint32_t m) {
+		uint32_t mask = uint32_t(mesh_index.size()) - 1;
+		uint32_t slot = h & mask;
+		while (mesh_index[slot].hash != 0) slot = (slot + 1) & mask;
+		mesh_index[slot].hash = h;
+		mesh_index[slot].mesh = m;
+	};
+
+	if (mesh_index.size() < 2 * meshes.size()) {
+		//grow (and rebuild) index, keeping it at most half full:
+		mesh_index.assign(std::max< size_t >(16, 2 * mesh_index.size()), IndexSlot());
+		for (uint32_t m = 0; m < meshes.size(); ++m) {
+			insert(hash_name(mesh_names[m]), m);
+		}
+	} else {
+		insert(hash, uint32_t(meshes.size() - 1));
+	}
+}
+
+uint32_t MeshBuffer::find_mesh(NameHash hash) const {
+	if (mesh_index.empty()) return -1U;
+	uint32_t mask = uint32_t(mesh_index.size()) - 1;
+	for (uint32_t slot = hash & mask; mesh_index[slot].hash != 0; slot = (slot + 1) & mask) {
+		if (mesh_index[slot].hash == hash) return mesh_index[slot].mesh;
+	}
+	return -1U;
+}
+
+uint32_t MeshBuffer::find_bundle_slot(NameHash hash) const {
+	uint32_t mask = uint32_t(bundle_toc.size()) - 1;
+	uint32_t slot = hash & mask;
+	for (uint32_t probes = 0; probes <= mask && bundle_toc[slot].hash != 0; ++probes) {
+		if (bundle_toc[slot].hash == hash) return slot;
+		slot = (slot + 1) & mask;
+	}
+	return -1U;
+}
+
+const Mesh &MeshBuffer::lookup(std::string_view name) const {
+	NameHash hash = hash_name(name);
+	//(names are compared too, since a name that isn't here could share a hash with one that is)
+	if (bundle_file) {
+		uint32_t slot = find_bundle_slot(hash);
+		if (slot != -1U) {
+			BundleEntry const &entry = bundle_toc[slot];
+			if (std::string_view(bundle_names.begin() + entry.name_begin, entry.name_end - entry.name_begin) == name) {
+				return make_resident(slot);
+			}
+		}
+	} else {
+		uint32_t m = find_mesh(hash);
+		if (m != -1U && mesh_names[m] == name) return meshes[m];
+	}
+	throw std::runtime_error("Looking up mesh '" + std::string(name) + "' that doesn't exist.");
+}
+
+const Mesh &MeshBuffer::lookup(NameHash hash) const {
+	if (bundle_file) {
+		uint32_t slot = find_bundle_slot(hash);
+		if (slot != -1U) return make_resident(slot);
+	} else {
+		uint32_t m = find_mesh(hash);
+		if (m != -1U) return meshes[m];
+	}
+	throw std::runtime_error("Looking up mesh with name hash " + std::to_string(hash) + " that doesn't exist.");
+}
+
+const Mesh &MeshBuffer::make_resident(uint32_t slot) const {
+	Residency &r = residency[slot];
+	r.last_used = epoch;
+	if (!r.resident) {
+		assert(buffer != 0 && "upload() should be called before lookup() on UploadLater bundles");
+		BundleEntry const &entry = bundle_toc[slot];
+
+		r.mesh.start = allocate(entry.vertex_count);
+
+		uint8_t const *bytes = bundle_data.begin() + entry.data_begin;
+		std::vector< uint8_t > decompressed;
+		if (entry.compression == BundleZlib) {
+			uLongf size = uLongf(entry.vertex_count * sizeof(PnctVertex));
+			decompressed.resize(size);
+			int ret = uncompress(decompressed.data(), &size, bytes, uLong(entry.data_end - entry.data_begin));
+			if (ret != Z_OK || size != decompressed.size()) {
+				release(r.mesh.start, entry.vertex_count);
+				std::string name(bundle_names.begin() + entry.name_begin, bundle_names.begin() + entry.name_end);
+				throw std::runtime_error("Failed to decompress mesh '" + name + "' (zlib error " + std::to_string(ret) + ").");
+			}
+			bytes = decompressed.data();
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, r.mesh.start * sizeof(PnctVertex), entry.vertex_count * sizeof(PnctVertex), bytes);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		r.resident = true;
+		resident_vertices += entry.vertex_count;
+	}
+	return r.mesh;
+}
+
+void MeshBuffer::evict_unused() {
+	for (uint32_t slot = 0; slot < residency.size(); ++slot) {
+		if (residency[slot].resident && residency[slot].last_used != epoch) evict(slot);
+	}
+	epoch += 1;
+}
+
+void MeshBuffer::evict(uint32_t slot) const {
+	Residency &r = residency[slot];
+	assert(r.resident);
+	r.resident = false;
+	resident_vertices -= r.mesh.count;
+	release(r.mesh.start, r.mesh.count);
+}
+
+void MeshBuffer::release(GLuint start, GLuint count) const {
+	//return space, merging with neighboring free ranges:
+	auto after = free_vertices.lower_bound(start);
+	if (after != free_vertices.end() && start + count == after->first) {
+		count += after->second;
+		after = free_vertices.erase(after);
+	}
+	if (after != free_vertices.begin()) {
+		auto before = std::prev(after);
+		if (before->first + before->second == start) {
+			before->second += count;
+			return;
+		}
+	}
+	free_vertices.emplace(start, count);
+}
+
+GLuint MeshBuffer::allocate(GLuint count) const {
+	while (true) {
+		//first fit:
+		for (auto f = free_vertices.begin(); f != free_vertices.end(); ++f) {
+			if (f->second < count) continue;
+			GLuint start = f->first;
+			GLuint left = f->second - count;
+			free_vertices.erase(f);
+			if (left) free_vertices.emplace(start + count, left);
+			return start;
+		}
+
+		//no room, so evict the least recently used mesh that isn't in use (which may take a few tries, since free space can be fragmented):
+		uint32_t oldest = -1U;
+		for (uint32_t slot = 0; slot < residency.size(); ++slot) {
+			Residency const &r = residency[slot];
+			if (!r.resident || r.last_used == epoch) continue;
+			if (oldest == -1U || r.last_used < residency[oldest].last_used) oldest = slot;
+		}
+		if (oldest == -1U) {
+			throw std::runtime_error("Mesh buffer budget is too small for the meshes in use (" + std::to_string(resident_vertices) + " vertices resident, need room for " + std::to_string(count) + " more).");
+		}
+		evict(oldest);
 	}
-	return f->second;
 }
 
 GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
@@ -128,6 +495,8 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//(element buffer binding is part of the vertex array object's state)
+	if (index_buffer != 0) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
 	glBindVertexArray(0);
 
 	//Check that all active attributes were bound:
@@ -5,23 +5,55 @@
  *  the OpenGL pipeline together.
  * A "MeshBuffer" holds a collection of such meshes (loaded from a file) in
  *  a single OpenGL array buffer. Individual meshes can be looked up by name
- *  using the MeshBuffer::lookup() function.
+ *  (or by name hash; see hash_name.hpp) using the MeshBuffer::lookup() function.
+ *
+ * MeshBuffers loaded from '.pnct' files upload every mesh when loaded.
+ * '.ipnct' files (also written by scenes/export-meshes.py) hold the same meshes with
+ *  duplicate vertices merged and triangles reordered for the post-transform cache,
+ *  drawn from an index buffer. Their vertices are quantized to 20 bytes (vs. 36):
+ *   Position -- 16-bit unsigned normalized, relative to the mesh's bounding box
+ *               (see Mesh::position_scale and position_offset)
+ *   Normal -- octahedral encoding in two signed bytes, followed by two zero bytes;
+ *             vertex shaders take a 'vec4 Normal' and decode it when w is zero
+ *             ('.pnct' normals have w == 1; see LitColorTextureProgram.cpp)
+ *   Color -- as in '.pnct'
+ *   TexCoord -- half floats
+ * MeshBuffers loaded from '.bundle' files (see MeshBundle.hpp) instead upload each
+ *  mesh the first time it is looked up, into a buffer of limited size; meshes that
+ *  go unused can be evicted to make room. So a big bundle only costs GPU memory for
+ *  the meshes that are actually drawn.
  *
  */
 
 #include "GL.hpp"
+#include "MappedFile.hpp"
+#include "MeshBundle.hpp"
+#include "hash_name.hpp"
+#include "read_write_chunk.hpp"
 #include <glm/glm.hpp>
 #include <map>
+#include <memory>
 #include <limits>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 struct Mesh {
 	//Meshes are vertex ranges (and primitive types) in their MeshBuffer:
 
 	GLenum type = GL_TRIANGLES; //type of primitives in mesh
-	GLuint start = 0; //index of first vertex
-	GLuint count = 0; //count of vertices
+	GLuint start = 0; //index of first vertex (for indexed meshes: of first index)
+	GLuint count = 0; //count of vertices (for indexed meshes: of indices)
+
+	//indexed meshes are drawn with glDrawElementsBaseVertex:
+	GLenum index_type = 0; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT (zero if not indexed)
+	GLint base_vertex = 0; //added to each index
+
+	//positions in the buffer map to object space as (position_offset + position_scale * Position):
+	// (quantized meshes use this to cover their bounding box)
+	glm::vec3 position_scale = glm::vec3(1.0f);
+	glm::vec3 position_offset = glm::vec3(0.0f);
 
 	//Bounding box.
 	//useful for debug visualization and (perhaps, eventually) collision detection:
@@ -30,13 +62,31 @@ struct Mesh {
 };
 
 struct MeshBuffer {
-	//construct from a file:
+	//construct from a file ('.pnct', '.ipnct', or '.bundle'):
 	// note: will throw if file fails to read.
-	MeshBuffer(std::string const &filename);
+	// with UploadLater, doesn't touch OpenGL (so can run on a loading thread; see Load.hpp) and upload() must be called before use.
+	// for bundles, 'budget' is the most vertex data (in bytes) to keep uploaded at once (0 means "enough for every mesh").
+	enum Upload { UploadNow, UploadLater };
+	MeshBuffer(std::string const &filename, Upload when = UploadNow, size_t budget = 0);
+
+	//copy vertex (and index) data read by the constructor to 'buffer' (or, for bundles, just make space for it) on the OpenGL thread:
+	void upload();
 
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
-	const Mesh &lookup(std::string const &name) const;
+	// for bundles, this uploads the mesh if it isn't resident (so must happen on the OpenGL thread) and marks it as used.
+	const Mesh &lookup(std::string_view name) const;
+
+	//..or by hash_name(name), which skips comparing names:
+	// (no two meshes in a buffer have the same hash -- the constructor checks -- but a name that
+	//  isn't in the buffer could still match one that is, so only use this for names known to be there)
+	const Mesh &lookup(NameHash hash) const;
+
+	//for bundles, evict the meshes that haven't been looked up since the last call to evict_unused():
+	// (when the buffer is full, lookup() also evicts such meshes, least recently used first)
+	// n.b. a Mesh -- in particular, its 'start' -- is only good while its mesh stays resident,
+	//  so code that calls evict_unused() should look up meshes each time it draws them.
+	void evict_unused();
 	
 	//build a vertex array object that links this vbo to attributes to a program:
 	// note: will throw if program defines attributes not contained in this buffer
@@ -44,11 +94,52 @@ struct MeshBuffer {
 
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
+	//..and, for indexed meshes, the element buffer (bound by make_vao_for_program):
+	GLuint index_buffer = 0;
 
 	//-- internals ---
 
-	//used by the lookup() function:
-	std::map< std::string, Mesh > meshes;
+	//meshes (in file order) and their names; empty for bundles:
+	std::vector< Mesh > meshes;
+	std::vector< std::string > mesh_names;
+
+	//flat hash index of meshes used by lookup():
+	// open-addressed, probed linearly from (hash & (size - 1)), and kept at most half full
+	struct IndexSlot {
+		NameHash hash = 0; //zero marks an empty slot
+		uint32_t mesh = 0; //index in meshes
+	};
+	std::vector< IndexSlot > mesh_index;
+	void add_mesh(std::string const &filename, std::string_view name, Mesh const &mesh); //(used while loading)
+	uint32_t find_mesh(NameHash hash) const; //index in meshes, or -1U if not found
+	uint32_t find_bundle_slot(NameHash hash) const; //slot in bundle_toc, or -1U if not found
+	const Mesh &make_resident(uint32_t slot) const; //(uploads bundle mesh if needed)
+
+	//bundle-only (residency changes in lookup(), hence 'mutable'):
+	std::unique_ptr< MappedFile > bundle_file; //stays mapped; the spans below point into it
+	ChunkSpan< BundleEntry > bundle_toc;
+	ChunkSpan< char > bundle_names;
+	ChunkSpan< uint8_t > bundle_data;
+	struct Residency {
+		Mesh mesh; //(start is only valid when resident)
+		bool resident = false;
+		uint32_t last_used = 0; //epoch of last lookup
+	};
+	mutable std::vector< Residency > residency; //one per bundle_toc slot
+	mutable uint32_t epoch = 1; //advanced by evict_unused()
+	mutable std::map< GLuint, GLuint > free_vertices; //unused ranges of 'buffer' (first vertex -> count)
+	GLuint capacity = 0; //vertices that fit in 'buffer'
+	mutable uint32_t resident_vertices = 0;
+	void evict(uint32_t slot) const;
+	void release(GLuint start, GLuint count) const; //return a range to free_vertices
+	GLuint allocate(GLuint count) const;
+
+	//vertex data waiting for upload() (points into pending_file):
+	std::unique_ptr< MappedFile > pending_file;
+	void const *pending_data = nullptr;
+	size_t pending_size = 0;
+	void const *pending_indices = nullptr;
+	size_t pending_indices_size = 0;
 
 	//These 'Attrib' structures describe the location of various attributes within the buffer (in exactly format wanted by glVertexAttribPointer). They are set when the file is loaded and are used by the "make_vao_for_program" call:
 	struct Attrib {
@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * Mesh bundles ('.bundle' files) hold the same meshes as '.pnct' files, laid out so that
+ * MeshBuffer can find and upload any one mesh without touching the others (see Mesh.hpp).
+ * scenes/pack-bundle.py makes them from '.pnct' files.
+ *
+ * A bundle is three chunks (in the format read by read_chunk):
+ *  toc0: BundleEntry * (a power of two) -- open-addressed hash table of meshes, keyed by
+ *        hash_name(name) (see hash_name.hpp) and probed linearly from (hash & (slots - 1));
+ *        no two meshes in a bundle have the same hash
+ *  str0: char * -- mesh names
+ *  dat0: uint8_t * -- each mesh's vertices (in '.pnct' format), stored raw or zlib-compressed
+ *
+ */
+
+#include "hash_name.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct BundleEntry {
+	NameHash hash; //hash_name(name); zero marks an empty slot
+	uint32_t name_begin, name_end; //in str0
+	uint32_t vertex_count;
+	uint32_t data_begin, data_end; //in dat0
+	uint32_t compression; //see below
+	uint32_t reserved; //(zero)
+	glm::vec3 min, max; //bounding box of vertex positions
+};
+static_assert(sizeof(BundleEntry) == 8*4 + 2*3*4, "BundleEntry is packed.");
+
+enum : uint32_t {
+	BundleRaw = 0, //vertex data is stored as-is
+	BundleZlib = 1, //vertex data is zlib-compressed
+};
@@ -0,0 +1,149 @@
+#include "OpusStream.hpp"
+
+#include <opusfile.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+//the longest opus frame is 120ms, so the decoder never returns more than this many samples at once:
+constexpr uint32_t const MaxFrame = 5760;
+
+struct OpusStream::Shared {
+	Shared() : op(nullptr, op_free) { }
+
+	std::string filename; //(for error messages)
+	std::unique_ptr< OggOpusFile, decltype(&op_free) > op;
+	bool loop = false;
+	bool looped = false; //seeked back to the start, and nothing decoded since (so a second EOF means there's nothing to loop)
+
+	//single-producer (decoding thread), single-consumer (audio thread) ring of decoded samples:
+	std::vector< float > ring = std::vector< float >(RingSize, 0.0f);
+	std::atomic< uint32_t > written{0}; //total samples written (wraps; only the decoder changes this)
+	std::atomic< uint32_t > consumed{0}; //total samples read (wraps; only the audio thread changes this)
+
+	std::atomic< bool > eof{false}; //decoder has written everything it ever will
+
+	//stop() sets 'quit' and signals 'wake', so the decoder doesn't sleep out its wait before exiting:
+	std::mutex quit_mutex;
+	std::condition_variable wake;
+	bool quit = false;
+
+	std::vector< float > pcm = std::vector< float >(2 * MaxFrame, 0.0f); //decoder scratch space
+
+	//decode one packet into the ring (ring must have MaxFrame free); returns false once there is nothing more to decode:
+	bool decode() {
+		int ret = op_read_float_stereo(op.get(), pcm.data(), int(pcm.size()));
+		if (ret == OP_HOLE) {
+			//(data missing from the file; opusfile will resync on the next read)
+			return true;
+		} else if (ret < 0) {
+			std::cerr << "opusfile read error " << ret << " streaming \"" << filename << "\"; stopping." << std::endl;
+			return false;
+		} else if (ret == 0) {
+			if (loop && !looped) {
+				int err = op_pcm_seek(op.get(), 0);
+				if (err == 0) {
+					looped = true;
+					return true;
+				}
+				std::cerr << "opusfile error " << err << " looping \"" << filename << "\"; stopping." << std::endl;
+			}
+			return false;
+		}
+
+		looped = false;
+		assert(uint32_t(ret) <= MaxFrame);
+		uint32_t w = written.load(std::memory_order_relaxed);
+		assert(RingSize - (w - consumed.load(std::memory_order_acquire)) >= uint32_t(ret));
+		for (uint32_t i = 0; i < uint32_t(ret); ++i) {
+			ring[(w + i) & (RingSize - 1)] = (pcm[2*i] + pcm[2*i+1]) * 0.5f; //downmix to mono by averaging
+		}
+		written.store(w + uint32_t(ret), std::memory_order_release);
+		return true;
+	}
+
+	uint32_t space() const {
+		return RingSize - (written.load(std::memory_order_relaxed) - consumed.load(std::memory_order_acquire));
+	}
+};
+
+OpusStream::OpusStream(std::string const &filename, bool loop) : shared(new Shared) {
+	static_assert((RingSize & (RingSize - 1)) == 0, "RingSize should be a power of two.");
+	static_assert(RingSize >= Prefill + MaxFrame, "Ring should hold the prefill and a frame.");
+
+	shared->filename = filename;
+	shared->loop = loop;
+
+	int err = 0;
+	shared->op.reset(op_open_file(filename.c_str(), &err));
+	if (err != 0 || !shared->op) {
+		throw std::runtime_error("opusfile error " + std::to_string(err) + " opening \"" + filename + "\".");
+	}
+
+	//decode just enough to start playing here, so the first read doesn't underrun:
+	while (shared->written.load(std::memory_order_relaxed) < Prefill) {
+		if (!shared->decode()) {
+			shared->eof.store(true, std::memory_order_release);
+			return;
+		}
+	}
+
+	//(the audio thread only ever copies out of the ring, so it never waits on this thread)
+	decoder = std::thread([s = shared.get()](){
+		std::unique_lock< std::mutex > lock(s->quit_mutex);
+		while (!s->quit) {
+			if (s->space() < MaxFrame) {
+				//ring is full; the audio thread drains ~1024 samples every ~21ms, so check back a bit more often:
+				s->wake.wait_for(lock, std::chrono::milliseconds(10));
+				continue;
+			}
+			lock.unlock();
+			bool more = s->decode();
+			lock.lock();
+			if (!more) break;
+		}
+		s->eof.store(true, std::memory_order_release);
+	});
+}
+
+OpusStream::~OpusStream() {
+	stop();
+}
+
+void OpusStream::stop() {
+	if (!decoder.joinable()) return;
+	{
+		std::lock_guard< std::mutex > lock(shared->quit_mutex);
+		shared->quit = true;
+	}
+	shared->wake.notify_all();
+	decoder.join();
+}
+
+uint32_t OpusStream::read(float *out, uint32_t count) {
+	Shared &s = *shared;
+	uint32_t r = s.consumed.load(std::memory_order_relaxed);
+	uint32_t available = s.written.load(std::memory_order_acquire) - r;
+	count = std::min(count, available);
+
+	//copy out, in (up to) two pieces because of wrap-around:
+	uint32_t at = r & (RingSize - 1);
+	uint32_t first = std::min(count, RingSize - at);
+	std::copy(s.ring.data() + at, s.ring.data() + at + first, out);
+	std::copy(s.ring.data(), s.ring.data() + (count - first), out + first);
+
+	s.consumed.store(r + count, std::memory_order_release);
+	return count;
+}
+
+bool OpusStream::finished() const {
+	Shared const &s = *shared;
+	//(eof is checked first, so 'written' is final by the time it's compared)
+	return s.eof.load(std::memory_order_acquire)
+	    && s.written.load(std::memory_order_acquire) == s.consumed.load(std::memory_order_relaxed);
+}
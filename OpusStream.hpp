@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * OpusStream plays an opus file (as 48kHz mono) while decoding it, instead of
+ * decoding the whole thing into a Sample up front. Meant for long music tracks:
+ *  - memory use is a fixed-size ring of decoded audio, however long the file;
+ *  - playback can start once a fraction of a second has been decoded.
+ *
+ * Decoding happens on a background thread that keeps the ring topped up;
+ * the audio thread only copies out of the ring, so it never waits on the decoder.
+ * The thread is joined when the stream is destroyed (always on the game thread)
+ * or when Sound::shutdown() stops it.
+ *
+ * Usage:
+ *   auto music = Sound::play(std::make_shared< OpusStream >(data_path("music.opus"), true));
+ *
+ */
+
+#include "Sound.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct OpusStream : Sound::Stream {
+	//opens 'filename' and decodes enough to start playing; throws on error:
+	OpusStream(std::string const &filename, bool loop = false);
+	virtual ~OpusStream();
+
+	//Sound::Stream interface (called from the audio thread):
+	virtual uint32_t read(float *out, uint32_t count) override;
+	virtual bool finished() const override;
+	//stops (and waits for) the decoding thread; called by the destructor and by Sound::shutdown():
+	virtual void stop() override;
+
+	//how much decoded audio is kept ready (must be a power of two):
+	static constexpr uint32_t RingSize = 1 << 16; //~1.4 seconds
+	//how much is decoded before playback starts:
+	static constexpr uint32_t Prefill = 4800; //0.1 seconds
+
+	//internals:
+	//(state shared with the decoding thread, which is joined before the OpusStream goes away)
+	struct Shared;
+	std::unique_ptr< Shared > shared;
+	std::thread decoder;
+};
@@ -4,6 +4,7 @@
 #include "PathFont.hpp"
 
 #include <iostream>
+#include <cassert>
 
 PathFont::PathFont(uint32_t glyphs_,
 	const float *glyph_widths_,
@@ -21,4 +22,68 @@ PathFont::PathFont(uint32_t glyphs_,
 			std::cerr << "WARNING: ignoring duplicate glyph for '" << str << "'." << std::endl;
 		}
 	}
+
+	//build trie from the (de-duplicated) map:
+	trie.emplace_back();
+	for (auto const &[str, glyph] : glyph_map) {
+		uint32_t node = 0;
+		for (char c : str) {
+			uint8_t b = uint8_t(c);
+			if (trie[node].next[b] == 0) {
+				trie[node].next[b] = uint32_t(trie.size());
+				trie.emplace_back();
+			}
+			node = trie[node].next[b];
+		}
+		trie[node].glyph = glyph;
+	}
+}
+
+float PathFont::layout(std::string const &text, std::vector< glm::vec2 > *points_) const {
+	assert(points_);
+	auto &points = *points_;
+
+	float anchor = 0.0f;
+	uint32_t start = 0;
+	while (start < text.size()) {
+		//longest glyph match (walks a trie, so no substrings are made):
+		uint32_t glyph;
+		uint32_t end = start + match(text.data() + start, text.data() + text.size(), &glyph);
+		if (glyph == -1U) {
+			assert(start == end);
+			end += 1;
+			//missing! draw a tofu:
+			for (const auto &pt : {
+				glm::vec2(0.1f, 0.1f), glm::vec2(0.6f, 0.1f),
+				glm::vec2(0.6f, 0.1f), glm::vec2(0.6f, 0.9f),
+				glm::vec2(0.9f, 0.6f), glm::vec2(0.1f, 0.9f),
+				glm::vec2(0.1f, 0.9f), glm::vec2(0.1f, 0.1f)
+			}) {
+				points.emplace_back(anchor + pt.x, pt.y);
+			}
+			anchor += 0.6f;
+		} else {
+			for (uint32_t c = glyph_coord_starts[glyph]; c + 1 < glyph_coord_starts[glyph+1]; c += 2) {
+				points.emplace_back(anchor + coords[c], coords[c+1]);
+			}
+			anchor += glyph_widths[glyph];
+		}
+		start = end;
+	}
+	return anchor;
+}
+
+uint32_t PathFont::match(char const *begin, char const *end, uint32_t *glyph) const {
+	uint32_t matched = 0;
+	*glyph = -1U;
+	uint32_t node = 0;
+	for (char const *c = begin; c != end; ++c) {
+		node = trie[node].next[uint8_t(*c)];
+		if (node == 0) break;
+		if (trie[node].glyph != -1U) {
+			matched = uint32_t(c + 1 - begin);
+			*glyph = trie[node].glyph;
+		}
+	}
+	return matched;
 }
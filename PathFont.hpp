@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 struct PathFont {
 	//meant to be intitialized with some pointers to constant data:
@@ -33,6 +34,22 @@ struct PathFont {
 	//computed in constructor:
 	std::map< std::string, uint32_t > glyph_map;
 
+	//lay out a string in glyph units (starting at the origin, 1 unit high), appending line endpoint pairs to 'points':
+	// (chars without glyphs get a tofu box); returns the total advance
+	float layout(std::string const &text, std::vector< glm::vec2 > *points) const;
+
+	//longest glyph whose chars are a prefix of [begin,end), without allocating:
+	// returns the number of chars matched (zero if no glyph matches) and sets *glyph
+	uint32_t match(char const *begin, char const *end, uint32_t *glyph) const;
+
+	//byte-wise trie over glyph chars, computed in constructor (used by match):
+	struct TrieNode {
+		uint32_t glyph = -1U; //glyph ending here, if any
+		uint32_t next[256]; //index of child node for each byte, or 0 (the root is never a child)
+		TrieNode() { std::fill(next, next + 256, 0U); }
+	};
+	std::vector< TrieNode > trie;
+
 	//the default font:
 	static PathFont font;
 };
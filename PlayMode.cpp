@@ -1,6 +1,8 @@
 #include "PlayMode.hpp"
 
 #include "DrawLines.hpp"
+#include "DrawCards.hpp"
+#include "DrawText.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
 #include "hex_dump.hpp"
@@ -13,7 +15,7 @@
 #include <string>
 #include <utility>
 
-PlayMode::PlayMode(Client &client_) : client(client_) {
+PlayMode::PlayMode(Client &client_) : solver(16), client(client_) {
 }
 
 PlayMode::~PlayMode() {
@@ -87,6 +89,20 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 			controls.xb.downs += 1;
 			controls.xb.pressed = true;
 			return true;
+		} else if (evt.key.keysym.sym == SDLK_h) {
+			//suggest a move for the local player (always first in the players list):
+			if (!game.players.empty()) {
+				Solver::Move move;
+				if (!solver.best_move(game.players.front(), HintDepth, &move)) {
+					hint = "no useful moves";
+				} else if (move.from == Solver::Move::Flip) {
+					hint = "hint: space";
+				} else {
+					hint = "hint: " + std::to_string(move.from) + " then " + std::to_string(move.to);
+				}
+				hint_hash = game.players.front().hash;
+			}
+			return true;
 		}
 	} else if (evt.type == SDL_KEYUP) {
 		if (evt.key.keysym.sym == SDLK_a) {
@@ -177,64 +193,11 @@ void PlayMode::update(float elapsed) {
 			}
 		}
 	}, 0.0);
-}
-
-glm::u8vec4 tuple_box_col(std::tuple<int, int, int, int> card) {
-	switch (std::get<2>(card)) {
-		case 0: // first select card
-			return glm::u8vec4(0xff, 0x00, 0xff, 0xff);
-		case 1: // second select card
-			return glm::u8vec4(0xff, 0x00, 0x00, 0xff);
-		default: // card not selected
-			return glm::u8vec4(0x00, 0x00, 0xff, 0xff);
-	}
-}
-
-glm::u8vec4 tuple_text_col(std::tuple<int, int, int, int> card) {
-	if (std::get<0>(card) < 2) {
-		return glm::u8vec4(0xff, 0x00, 0x00, 0xff);
-	} else {
-		return glm::u8vec4(0xff, 0xff, 0xff, 0xff);
-	}
-}
 
-std::string tuple_to_string(std::tuple<int, int, int, int> card) {
-	std::string res = "";
-	switch(std::get<0>(card)) {
-		case 0:
-			res += "D";
-			break;
-		case 1:
-			res += "H";
-			break;
-		case 2:
-			res += "C";
-			break;
-		default:
-			res += "S";
-			break;
-	}
-	res += " ";
-	switch (std::get<1>(card)) {
-		case 12:
-			res += "K";
-			break;
-		case 11:
-			res += "Q";
-			break;
-		case 10:
-			res += "J";
-			break;
-		case 0:
-			res += "A";
-			break;
-		case -1:
-			break;
-		default:
-			res += std::to_string(std::get<1>(card) + 1);
-			break;
+	//a hint only applies to the state it was made for:
+	if (!hint.empty() && (game.players.empty() || game.players.front().hash != hint_hash)) {
+		hint.clear();
 	}
-	return res;
 }
 
 void PlayMode::draw(glm::uvec2 const &drawable_size) {
@@ -259,19 +222,16 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	);
 
 	{
+		//n.b. destructors run in reverse order, so cards are drawn first, then lines, then text on top:
+		DrawText text(world_to_clip);
 		DrawLines lines(world_to_clip);
+		DrawCards cards(world_to_clip);
+		cards.label_offset = TableLayout::LabelOffset / TableLayout::CardHeight;
+		cards.label_height = TableLayout::LabelHeight / TableLayout::CardHeight;
 
 		//helper:
-		auto draw_text = [&](glm::vec2 const &at, std::string const &text, float H, glm::u8vec4 col) {
-			lines.draw_text(text,
-				glm::vec3(at.x, at.y, 0.0),
-				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-				col);
-			float ofs = (1.0f / scale) / drawable_size.y;
-			lines.draw_text(text,
-				glm::vec3(at.x + ofs, at.y + ofs, 0.0),
-				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-				col);
+		auto draw_text = [&](glm::vec2 const &at, std::string const &str, float H, glm::u8vec4 col) {
+			text.draw(str, at, glm::vec2(H, 0.0f), glm::vec2(0.0f, H), col);
 		};
 
 		lines.draw(glm::vec3(Game::ArenaMin.x, Game::ArenaMin.y, 0.0f), glm::vec3(Game::ArenaMax.x, Game::ArenaMin.y, 0.0f), glm::u8vec4(0xff, 0x00, 0xff, 0xff));
@@ -282,109 +242,20 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 
 		lines.draw_quad(Game::ArenaMin.x, Game::ArenaMin.y, Game::ArenaMax.x, Game::ArenaMax.y, glm::u8vec4(0x00, 0x00, 0xff, 0xff));
 
-		float forthW = (Game::ArenaMax.x - Game::ArenaMin.x - 0.1f * 6.0f) / 5.0;
-
-		bool done = false;
-		for (auto const &player : game.players) {
-			if (player.done) {
-				done = true;
-			}
+		//cards and labels (rebuilt only when a new state has arrived or the view changes):
+		TableLayout::View view;
+		view.min = -offset - glm::vec2(aspect, 1.0f) / scale;
+		view.max = -offset + glm::vec2(aspect, 1.0f) / scale;
+		view.pixels_per_unit = 0.5f * scale * drawable_size.y;
+		layout.update(game, view);
+		cards.instances.insert(cards.instances.end(), layout.cards.begin(), layout.cards.end());
+		for (auto const &t : layout.texts) {
+			draw_text(t.at, t.text, t.height, t.color);
 		}
 
-		for (auto const &player : game.players) {
-			glm::u8vec4 col = glm::u8vec4(player.color.x*255, player.color.y*255, player.color.z*255, 0xff);
-			if (&player == &game.players.front()) {
-				// Draw neg_pile
-				if (player.neg_pile.size() > 0) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f, Game::ArenaMin.y + 0.1f + 0.05f * 12, Game::ArenaMin.x + 0.1f + forthW, Game::ArenaMin.y + 0.1f + 0.05f * 13, tuple_box_col(game.players.front().neg_pile.back()));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMin.y + 0.1f + 0.05f * 12), tuple_to_string(player.neg_pile.back()), 0.04f, tuple_text_col(game.players.front().neg_pile.back()));
-				} else {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f, Game::ArenaMin.y + 0.1f + 0.05f * 12, Game::ArenaMin.x + 0.1f + forthW, Game::ArenaMin.y + 0.1f + 0.05f * 13, glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMin.y + 0.1f + 0.05f * 12), "end", 0.04f, glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-				}
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMin.y + 0.1f + 0.05f * 11), std::to_string(game.players.front().neg_pile.size()), 0.04f, glm::u8vec4(0xff, 0xff, 0xff, 0xff));
-				
-				// Draw pos_pile
-				if (player.pos_pile.size() > 0) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f, Game::ArenaMin.y + 0.1f, Game::ArenaMin.x + 0.1f + forthW, Game::ArenaMin.y + 0.1f + 0.05f, tuple_box_col(player.pos_pile.at(player.pos_pos)));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMin.y + 0.1f), tuple_to_string(player.pos_pile.at(player.pos_pos)), 0.04f, tuple_text_col(player.pos_pile.at(player.pos_pos)));
-				} else {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f, Game::ArenaMin.y + 0.1f, Game::ArenaMin.x + 0.1f + forthW, Game::ArenaMin.y + 0.1f + 0.05f, glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMin.y + 0.1f), "none", 0.04f, glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-				}
-
-				// Draw active piles
-				for (int i = 0; i < player.one.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 1, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 1, Game::ArenaMin.y + 0.1f + 0.05f * (13 - i), tuple_box_col(player.one.at(i)));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 1, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i)), tuple_to_string(player.one.at(i)), 0.04f, tuple_text_col(player.one.at(i)));
-				}
-				for (int i = 0; i < player.two.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 2, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 2, Game::ArenaMin.y + 0.1f + 0.05f * (13 - i), tuple_box_col(player.two.at(i)));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 2, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i)), tuple_to_string(player.two.at(i)), 0.04f, tuple_text_col(player.two.at(i)));
-				}
-				for (int i = 0; i < player.three.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 3, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 3, Game::ArenaMin.y + 0.1f + 0.05f * (13 - i), tuple_box_col(player.three.at(i)));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 3, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i)), tuple_to_string(player.three.at(i)), 0.04f, tuple_text_col(player.three.at(i)));
-				}
-				for (int i = 0; i < player.four.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 4, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 4, Game::ArenaMin.y + 0.1f + 0.05f * (13 - i), tuple_box_col(player.four.at(i)));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 4, Game::ArenaMin.y + 0.1f + 0.05f * (12 - i)), tuple_to_string(player.four.at(i)), 0.04f, tuple_text_col(player.four.at(i)));
-				}
-
-				// Draw suit piles
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 1, Game::ArenaMin.y + 0.1f + 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 1, Game::ArenaMin.y + 0.1f + 0.05f * 16, tuple_box_col(player.D));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 1, Game::ArenaMin.y + 0.1f + 0.05f * 15), tuple_to_string(player.D), 0.04f, tuple_text_col(player.D));
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 2, Game::ArenaMin.y + 0.1f + 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 2, Game::ArenaMin.y + 0.1f + 0.05f * 16, tuple_box_col(player.H));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 2, Game::ArenaMin.y + 0.1f + 0.05f * 15), tuple_to_string(player.H), 0.04f, tuple_text_col(player.H));
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 3, Game::ArenaMin.y + 0.1f + 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 3, Game::ArenaMin.y + 0.1f + 0.05f * 16, tuple_box_col(player.C));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 3, Game::ArenaMin.y + 0.1f + 0.05f * 15), tuple_to_string(player.C), 0.04f, tuple_text_col(player.C));
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 4, Game::ArenaMin.y + 0.1f + 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 4, Game::ArenaMin.y + 0.1f + 0.05f * 16, tuple_box_col(player.S));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 4, Game::ArenaMin.y + 0.1f + 0.05f * 15), tuple_to_string(player.S), 0.04f, tuple_text_col(player.S));
-
-			} else {
-				// Draw neg_pile
-				if (player.neg_pile.size() > 0) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f, Game::ArenaMax.y - 0.1f - 0.05f * 12, Game::ArenaMin.x + 0.1f + forthW, Game::ArenaMax.y - 0.1f - 0.05f * 13, glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMax.y - 0.1f - 0.05f * 13), tuple_to_string(player.neg_pile.back()), 0.04f, tuple_text_col(player.neg_pile.back()));
-				} else {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f, Game::ArenaMax.y - 0.1f - 0.05f * 12, Game::ArenaMin.x + 0.1f + forthW, Game::ArenaMax.y - 0.1f - 0.05f * 13, glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMax.y - 0.1f - 0.05f * 13), "end", 0.04f, glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-				}
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMax.y - 0.1f - 0.05f * 12), std::to_string(player.neg_pile.size()), 0.04f, glm::u8vec4(0xff, 0xff, 0xff, 0xff));
-				
-				// Draw score if applicable -- don't care about other player's pos_pile
-				if (done) {
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f, Game::ArenaMax.y - 0.1f - 0.05f), std::to_string(game.players.front().score) + " vs. " + std::to_string(player.score), 0.04f, glm::u8vec4(0xff, 0xff, 0xff, 0xff));
-				}
-
-				// Draw active piles
-				for (int i = 0; i < player.one.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 1, Game::ArenaMax.y - 0.1f - 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 1, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i), glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 1, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i)), tuple_to_string(player.one.at(i)), 0.04f, tuple_text_col(player.one.at(i)));
-				}
-				for (int i = 0; i < player.two.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 2, Game::ArenaMax.y - 0.1f - 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 2, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i), glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 2, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i)), tuple_to_string(player.two.at(i)), 0.04f, tuple_text_col(player.two.at(i)));
-				}
-				for (int i = 0; i < player.three.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 3, Game::ArenaMax.y - 0.1f - 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 3, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i), glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 3, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i)), tuple_to_string(player.three.at(i)), 0.04f, tuple_text_col(player.three.at(i)));
-				}
-				for (int i = 0; i < player.four.size(); i++) {
-					lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 4, Game::ArenaMax.y - 0.1f - 0.05f * (12 - i), Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 4, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i), glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-					draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 4, Game::ArenaMax.y - 0.1f - 0.05f * (13 - i)), tuple_to_string(player.four.at(i)), 0.04f, tuple_text_col(player.four.at(i)));
-				}
-
-				// Draw suit piles
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 1, Game::ArenaMax.y - 0.1f - 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 1, Game::ArenaMax.y - 0.1f - 0.05f * 16, glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 1, Game::ArenaMax.y - 0.1f - 0.05f * 16), tuple_to_string(player.D), 0.04f, tuple_text_col(player.D));
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 2, Game::ArenaMax.y - 0.1f - 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 2, Game::ArenaMax.y - 0.1f - 0.05f * 16, glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 2, Game::ArenaMax.y - 0.1f - 0.05f * 16), tuple_to_string(player.H), 0.04f, tuple_text_col(player.H));
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 3, Game::ArenaMax.y - 0.1f - 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 3, Game::ArenaMax.y - 0.1f - 0.05f * 16, glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 3, Game::ArenaMax.y - 0.1f - 0.05f * 16), tuple_to_string(player.C), 0.04f, tuple_text_col(player.C));
-				lines.draw_quad(Game::ArenaMin.x + 0.1f + (forthW + 0.1f) * 4, Game::ArenaMax.y - 0.1f - 0.05f * 15, Game::ArenaMin.x + 0.1f + forthW + (forthW + 0.1f) * 4, Game::ArenaMax.y - 0.1f - 0.05f * 16, glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-				draw_text(glm::vec2(Game::ArenaMin.x + 0.1f + 0.075f + (forthW + 0.1f) * 4, Game::ArenaMax.y - 0.1f - 0.05f * 16), tuple_to_string(player.S), 0.04f, tuple_text_col(player.S));
-			}
+		// Draw hint (if requested)
+		if (!hint.empty()) {
+			draw_text(glm::vec2(TableLayout::cell(true, 1, 0).x, Game::ArenaMin.y + 0.03f), hint, 0.04f, glm::u8vec4(0xff, 0xff, 0x00, 0xff));
 		}
 	}
 	GL_ERRORS();
@@ -2,6 +2,8 @@
 
 #include "Connection.hpp"
 #include "Game.hpp"
+#include "Solver.hpp"
+#include "TableLayout.hpp"
 
 #include <glm/glm.hpp>
 
@@ -25,9 +27,18 @@ struct PlayMode : Mode {
 	//latest game state (from server):
 	Game game;
 
+	//cards and labels for 'game', re-laid-out only when a new state arrives (or the view changes):
+	TableLayout layout;
+
 	//last message from server:
 	std::string server_message;
 
+	//'h' asks the solver for a move suggestion:
+	Solver solver;
+	inline static constexpr uint32_t HintDepth = 6;
+	std::string hint;
+	uint64_t hint_hash = 0; //local player's hash when 'hint' was made (it is cleared once that changes)
+
 	//connection to server:
 	Client &client;
 
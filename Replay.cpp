@@ -0,0 +1,217 @@
+#include "Replay.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+//-----------------------------------------
+
+ReplayRecorder::ReplayRecorder(std::string const &filename, uint32_t seed) : file(filename, std::ios::binary) {
+	if (!file) {
+		throw std::runtime_error("Failed to open replay file '" + filename + "' for writing.");
+	}
+	file.write("rpl0", 4);
+	file.write(reinterpret_cast< char const * >(&seed), sizeof(seed));
+	file.flush();
+}
+
+void ReplayRecorder::write(ReplayEvent const &event) {
+	file.write(reinterpret_cast< char const * >(&event), sizeof(event));
+	last_write = event.tick;
+}
+
+void ReplayRecorder::spawn(Player const *player) {
+	assert(player);
+	Recorded &r = recorded[player];
+	r.player = next_player++;
+	Player::Controls().pack(r.controls); //new players start with nothing pressed
+
+	ReplayEvent event;
+	event.tick = tick;
+	event.player = r.player;
+	event.type = ReplayEvent::Spawn;
+	write(event);
+}
+
+void ReplayRecorder::remove(Player const *player) {
+	auto f = recorded.find(player);
+	assert(f != recorded.end());
+
+	ReplayEvent event;
+	event.tick = tick;
+	event.player = f->second.player;
+	event.type = ReplayEvent::Remove;
+	write(event);
+
+	recorded.erase(f);
+}
+
+void ReplayRecorder::begin_tick(Game const &game) {
+	//only record controls that differ from what update() left behind,
+	// since that's all the replay needs to reconstruct the rest:
+	for (auto const &player : game.players) {
+		auto f = recorded.find(&player);
+		assert(f != recorded.end());
+
+		uint8_t controls[Player::Controls::PackedSize];
+		player.controls.pack(controls);
+		if (std::memcmp(controls, f->second.controls, sizeof(controls)) == 0) continue;
+
+		ReplayEvent event;
+		event.tick = tick;
+		event.player = f->second.player;
+		event.type = ReplayEvent::Controls;
+		std::memcpy(event.controls, controls, sizeof(controls));
+		write(event);
+	}
+}
+
+void ReplayRecorder::end_tick(Game const &game) {
+	for (auto const &player : game.players) {
+		auto f = recorded.find(&player);
+		assert(f != recorded.end());
+		player.controls.pack(f->second.controls);
+	}
+
+	tick += 1;
+
+	if (tick - last_write >= mark_interval) {
+		ReplayEvent event;
+		event.tick = tick;
+		event.type = ReplayEvent::Mark;
+		write(event);
+	}
+
+	file.flush();
+}
+
+//-----------------------------------------
+
+ReplayLog::ReplayLog(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+
+	char magic[4];
+	if (!file.read(magic, 4) || std::string(magic, 4) != "rpl0") {
+		throw std::runtime_error("Replay file '" + filename + "' doesn't start with 'rpl0'.");
+	}
+	if (!file.read(reinterpret_cast< char * >(&seed), sizeof(seed))) {
+		throw std::runtime_error("Replay file '" + filename + "' is missing its seed.");
+	}
+
+	//read everything else in one go and split it into events:
+	std::vector< char > data(std::istreambuf_iterator< char >(file), {});
+	if (data.size() % sizeof(ReplayEvent) != 0) {
+		//probably the server stopped mid-write; the complete events are still useful:
+		std::cerr << "WARNING: ignoring partial event at the end of replay file '" << filename << "'." << std::endl;
+	}
+	events.resize(data.size() / sizeof(ReplayEvent));
+	if (!events.empty()) {
+		std::memcpy(events.data(), data.data(), events.size() * sizeof(ReplayEvent));
+	}
+
+	for (size_t i = 0; i < events.size(); ++i) {
+		ReplayEvent const &e = events[i];
+		if (!(e.type == ReplayEvent::Spawn || e.type == ReplayEvent::Remove || e.type == ReplayEvent::Controls || e.type == ReplayEvent::Mark)) {
+			throw std::runtime_error("Replay file '" + filename + "' contains event of unknown type " + std::to_string(int(e.type)) + ".");
+		}
+		if (i > 0 && e.tick < events[i-1].tick) {
+			throw std::runtime_error("Replay file '" + filename + "' contains events out of tick order.");
+		}
+	}
+}
+
+//-----------------------------------------
+
+ReplaySimulator::ReplaySimulator(ReplayLog const &log_, uint32_t checkpoint_interval_) : log(log_), checkpoint_interval(checkpoint_interval_) {
+	game.mt.seed(log.seed);
+
+	//always have a checkpoint to seek back to:
+	checkpoints.emplace_back(Checkpoint{0, 0, 0, game, {}});
+}
+
+uint32_t ReplaySimulator::end_tick() const {
+	if (log.events.empty()) return 0;
+	return log.events.back().tick + 1;
+}
+
+Player *ReplaySimulator::player(uint32_t number) {
+	if (number < players.size()) return players[number];
+	else return nullptr;
+}
+
+void ReplaySimulator::step() {
+	while (next_event < log.events.size() && log.events[next_event].tick == tick) {
+		ReplayEvent const &e = log.events[next_event];
+		if (e.type == ReplayEvent::Spawn) {
+			if (e.player != players.size()) {
+				throw std::runtime_error("Replay spawns player " + std::to_string(e.player) + " out of order.");
+			}
+			players.emplace_back(game.spawn_player());
+		} else if (e.type == ReplayEvent::Remove) {
+			Player *p = player(e.player);
+			if (!p) throw std::runtime_error("Replay removes missing player " + std::to_string(e.player) + ".");
+			game.remove_player(p);
+			players[e.player] = nullptr;
+		} else if (e.type == ReplayEvent::Controls) {
+			Player *p = player(e.player);
+			if (!p) throw std::runtime_error("Replay has controls for missing player " + std::to_string(e.player) + ".");
+			p->controls.unpack(e.controls);
+		} else { assert(e.type == ReplayEvent::Mark);
+			//nothing to do.
+		}
+		++next_event;
+	}
+
+	game.update(Game::Tick);
+	tick += 1;
+
+	if (checkpoint_interval != 0 && tick % checkpoint_interval == 0 && checkpoints.back().tick < tick) {
+		std::unordered_map< Player const *, uint32_t > numbers;
+		for (uint32_t n = 0; n < players.size(); ++n) {
+			if (players[n]) numbers.emplace(players[n], n);
+		}
+		checkpoints.emplace_back(Checkpoint{tick, next_event, uint32_t(players.size()), game, {}});
+		checkpoints.back().numbers.reserve(game.players.size());
+		for (auto const &p : game.players) {
+			checkpoints.back().numbers.emplace_back(numbers.at(&p));
+		}
+	}
+}
+
+void ReplaySimulator::run_to(uint32_t target) {
+	while (tick < target) {
+		step();
+	}
+}
+
+void ReplaySimulator::seek(uint32_t target) {
+	//latest checkpoint at or before target:
+	auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), target, [](uint32_t t, Checkpoint const &c) {
+		return t < c.tick;
+	});
+	assert(after != checkpoints.begin()); //(there is always a checkpoint at tick zero)
+	Checkpoint const &checkpoint = *(after - 1);
+
+	//only restore if it saves work (or if going backward):
+	if (target < tick || checkpoint.tick > tick) {
+		restore(checkpoint);
+	}
+	run_to(target);
+}
+
+void ReplaySimulator::restore(Checkpoint const &checkpoint) {
+	game = checkpoint.game;
+	tick = checkpoint.tick;
+	next_event = checkpoint.next_event;
+
+	//Player pointers changed with the copy, so rebuild the spawn number -> player table:
+	players.assign(checkpoint.spawned, nullptr);
+	assert(checkpoint.numbers.size() == game.players.size());
+	auto n = checkpoint.numbers.begin();
+	for (auto &p : game.players) {
+		players[*n] = &p;
+		++n;
+	}
+}
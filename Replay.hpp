@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * Replay logs record everything that feeds Game::update on the server
+ *  (the shuffle seed, player joins/leaves, and controls changes) so that
+ *  a match can be re-simulated later without the network or the 30Hz clock.
+ *
+ * Recording (server.cpp):
+ *   ReplayRecorder recorder("match.replay", seed);
+ *   //...on connect/disconnect: recorder.spawn(player) / recorder.remove(player)
+ *   recorder.begin_tick(game); game.update(Game::Tick); recorder.end_tick(game);
+ *
+ * Playback (replay.cpp):
+ *   ReplayLog log("match.replay");
+ *   ReplaySimulator sim(log);
+ *   sim.run_to(sim.end_tick()); //as fast as update() allows
+ *   sim.seek(1234); //restores nearest checkpoint, then simulates forward
+ *
+ */
+
+#include "Game.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+
+//on-disk records:
+// |r|p|l|0| <-- magic
+// |seed   | <-- (native endian) seed for Game::mt
+// ReplayEvent * (until end of file)
+struct ReplayEvent {
+	enum Type : uint8_t {
+		Spawn = 's', //player joined (Game::spawn_player)
+		Remove = 'r', //player left (Game::remove_player)
+		Controls = 'c', //player's controls changed since the end of the last tick
+		Mark = 'm', //nothing happened; records the passage of time
+	};
+	uint32_t tick = 0; //number of Game::update calls made before this event
+	uint32_t player = 0; //players are numbered in spawn order, starting at zero
+	Type type = Mark;
+	uint8_t padding[3] = {0, 0, 0};
+	uint8_t controls[Player::Controls::PackedSize] = {0}; //(only meaningful for 'Controls' events)
+};
+static_assert(sizeof(ReplayEvent) == 4 + 4 + 1 + 3 + Player::Controls::PackedSize, "ReplayEvent is packed.");
+
+struct ReplayRecorder {
+	//start writing a log; throws if file can't be opened:
+	ReplayRecorder(std::string const &filename, uint32_t seed);
+
+	void spawn(Player const *player);
+	void remove(Player const *player);
+
+	//call immediately before / after each Game::update:
+	void begin_tick(Game const &game); //records controls that changed since end_tick
+	void end_tick(Game const &game); //remembers post-update controls and flushes the file
+
+	//a Mark is written at least this often, so logs capture idle time at the end of a match:
+	uint32_t mark_interval = 30;
+
+	//internals:
+	std::ofstream file;
+	uint32_t tick = 0;
+	uint32_t last_write = 0; //tick of last written event
+	uint32_t next_player = 0;
+	struct Recorded {
+		uint32_t player;
+		uint8_t controls[Player::Controls::PackedSize];
+	};
+	std::unordered_map< Player const *, Recorded > recorded;
+	void write(ReplayEvent const &event);
+};
+
+struct ReplayLog {
+	//read a log; throws on malformed files:
+	ReplayLog(std::string const &filename);
+
+	uint32_t seed = 0;
+	std::vector< ReplayEvent > events; //sorted by tick
+};
+
+struct ReplaySimulator {
+	//n.b. keeps a reference to the log:
+	ReplaySimulator(ReplayLog const &log, uint32_t checkpoint_interval = 300);
+
+	//game state being simulated:
+	Game game;
+	uint32_t tick = 0; //number of updates applied to 'game'
+
+	//tick after which the log has no more events:
+	uint32_t end_tick() const;
+
+	//advance one tick (apply this tick's events, then Game::update):
+	void step();
+	//advance until 'tick' == target (no-op if already there or past it):
+	void run_to(uint32_t target);
+	//move to any tick, forward or backward, via the nearest earlier checkpoint:
+	void seek(uint32_t target);
+
+	//look up a player by spawn number (nullptr if not [yet/still] in the game):
+	Player *player(uint32_t number);
+
+	//internals:
+	ReplayLog const &log;
+	size_t next_event = 0; //index into log.events
+	std::vector< Player * > players; //by spawn number
+
+	//checkpoints are taken automatically when step() reaches a multiple of the interval:
+	uint32_t checkpoint_interval;
+	struct Checkpoint {
+		uint32_t tick;
+		size_t next_event;
+		uint32_t spawned; //players.size() at checkpoint
+		Game game;
+		std::vector< uint32_t > numbers; //spawn number of each entry of game.players
+	};
+	std::vector< Checkpoint > checkpoints; //sorted by tick
+	void restore(Checkpoint const &checkpoint);
+};
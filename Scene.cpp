@@ -2,10 +2,25 @@
 
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+//-------------------------
+
+void Scene::Drawable::Pipeline::set_mesh(Mesh const &mesh) {
+	type = mesh.type;
+	start = mesh.start;
+	count = mesh.count;
+	index_type = mesh.index_type;
+	base_vertex = mesh.base_vertex;
+	position_scale = mesh.position_scale;
+	position_offset = mesh.position_offset;
+}
 
 //-------------------------
 
@@ -71,6 +86,55 @@ glm::mat4x3 Scene::Transform::make_world_to_local() const {
 	}
 }
 
+void Scene::update_transforms() const {
+	update_pass += 1;
+	uint32_t pass = update_pass;
+
+	//order transforms so parents come before children:
+	// (walks up from each transform only as far as the first ancestor already placed, so this is linear in the number of transforms)
+	auto &order = update_order;
+	auto &chain = update_chain;
+	order.clear();
+	for (auto const &transform : transforms) {
+		chain.clear();
+		for (Transform const *t = &transform; t && t->cached.ordered != pass; t = t->parent) {
+			t->cached.ordered = pass;
+			chain.emplace_back(t);
+		}
+		order.insert(order.end(), chain.rbegin(), chain.rend());
+	}
+
+	//flat pass, recomputing only what changed:
+	for (Transform const *t : order) {
+		auto &cached = t->cached;
+		bool changed = false;
+		if (!cached.valid || cached.position != t->position || cached.rotation != t->rotation || cached.scale != t->scale) {
+			t->local_to_parent = t->make_local_to_parent();
+			cached.position = t->position;
+			cached.rotation = t->rotation;
+			cached.scale = t->scale;
+			changed = true;
+		}
+		if (!cached.valid || cached.parent != t->parent) {
+			cached.parent = t->parent;
+			changed = true;
+		}
+		if (t->parent && t->parent->cached.changed == pass) {
+			changed = true;
+		}
+		cached.valid = true;
+
+		if (changed) {
+			if (t->parent) {
+				t->local_to_world = t->parent->local_to_world * glm::mat4(t->local_to_parent); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+			} else {
+				t->local_to_world = t->local_to_parent;
+			}
+			cached.changed = pass;
+		}
+	}
+}
+
 //-------------------------
 
 glm::mat4 Scene::Camera::make_projection() const {
@@ -88,11 +152,29 @@ void Scene::draw(Camera const &camera) const {
 }
 
 void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	update_transforms();
 
-	//Iterate through all drawables, sending each one to OpenGL:
+	draw_list.clear();
 	for (auto const &drawable : drawables) {
-		//Reference to drawable's pipeline for convenience:
-		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+		assert(drawable.transform); //drawables *must* have a transform
+		draw_list.emplace_back(DrawItem{&drawable.pipeline, &drawable.transform->local_to_world}); //(updated above)
+	}
+
+	draw_items(draw_list, &draw_queue, world_to_clip, world_to_light);
+}
+
+void Scene::draw_items(std::vector< DrawItem > const &items, std::vector< QueuedItem > *queue_, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) {
+	assert(queue_);
+	auto &queue = *queue_;
+
+	//Build a render queue: items are sorted by a key made from the state they need,
+	// so items that share a program / vertex array / texture are drawn back-to-back
+	// (and, within those, front-to-back, which helps early depth testing):
+	queue.clear();
+
+	for (uint32_t index = 0; index < items.size(); ++index) {
+		//Reference to item's pipeline for convenience:
+		Scene::Drawable::Pipeline const &pipeline = *items[index].pipeline;
 
 		//skip any drawables without a shader program set:
 		if (pipeline.program == 0) continue;
@@ -101,22 +183,69 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
 
+		glm::mat4x3 const &object_to_world = *items[index].object_to_world;
+
+		//view depth of the object's origin; positive floats sort the same as their bit patterns,
+		// so the top 16 bits make a (coarse) depth key:
+		float w = (world_to_clip * glm::vec4(object_to_world[3], 1.0f)).w;
+		uint32_t w_bits;
+		static_assert(sizeof(w_bits) == sizeof(w), "float is 32 bits.");
+		std::memcpy(&w_bits, &w, sizeof(w));
+		uint64_t depth = (w > 0.0f ? (w_bits >> 16) : 0);
+
+		//n.b. GL object names are only truncated here, so collisions can only cost some extra binds:
+		uint64_t key = (uint64_t(pipeline.program & 0xffff) << 48)
+		             | (uint64_t(pipeline.vao & 0xffff) << 32)
+		             | (uint64_t(pipeline.textures[0].texture & 0xffff) << 16)
+		             | depth;
+
+		queue.emplace_back(QueuedItem{key, index, items[index]});
+	}
+
+	std::sort(queue.begin(), queue.end());
+
+	//Send the queue to OpenGL, only changing state that differs from the previous drawable's:
+	GLuint current_program = 0;
+	GLuint current_vao = 0;
+	Drawable::Pipeline::TextureInfo current_textures[Drawable::Pipeline::TextureCount];
+	uint32_t current_unit = -1U; //(unknown until first set)
+	auto active_texture = [&](uint32_t unit) {
+		if (current_unit == unit) return;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		current_unit = unit;
+	};
+
+	for (auto const &queued : queue) {
+		Scene::Drawable::Pipeline const &pipeline = *queued.item.pipeline;
 
 		//Set shader program:
-		glUseProgram(pipeline.program);
+		if (pipeline.program != current_program) {
+			glUseProgram(pipeline.program);
+			current_program = pipeline.program;
+		}
 
 		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+		if (pipeline.vao != current_vao) {
+			glBindVertexArray(pipeline.vao);
+			current_vao = pipeline.vao;
+		}
 
 		//Configure program uniforms:
 
 		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+		glm::mat4x3 const &object_to_world = *queued.item.object_to_world;
+
+		//(quantized) vertex positions are scaled and offset into object space first:
+		// n.b. this is folded into the two position matrices, but not NORMAL_TO_LIGHT, since normals aren't quantized this way
+		glm::mat4x3 vertex_to_world = object_to_world;
+		vertex_to_world[0] *= pipeline.position_scale.x;
+		vertex_to_world[1] *= pipeline.position_scale.y;
+		vertex_to_world[2] *= pipeline.position_scale.z;
+		vertex_to_world[3] = object_to_world * glm::vec4(pipeline.position_offset, 1.0f);
 
 		//OBJECT_TO_CLIP takes vertices from object space to clip space:
 		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
+			glm::mat4 object_to_clip = world_to_clip * glm::mat4(vertex_to_world);
 			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
 		}
 
@@ -125,7 +254,8 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 
 		//OBJECT_TO_CLIP takes vertices from object space to light space:
 		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
+			glm::mat4x3 vertex_to_light = world_to_light * glm::mat4(vertex_to_world);
+			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(vertex_to_light));
 		}
 
 		//NORMAL_TO_CLIP takes normals from object space to light space:
@@ -137,27 +267,38 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		//set any requested custom uniforms:
 		if (pipeline.set_uniforms) pipeline.set_uniforms();
 
-		//set up textures:
+		//set up textures (units a drawable doesn't use are left empty, as if each drawable un-bound its textures):
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+			auto const &want = pipeline.textures[i];
+			auto &have = current_textures[i];
+			if (want.texture == have.texture && (want.texture == 0 || want.target == have.target)) continue;
+			active_texture(i);
+			if (have.texture != 0 && (want.texture == 0 || want.target != have.target)) {
+				glBindTexture(have.target, 0);
+			}
+			if (want.texture != 0) {
+				glBindTexture(want.target, want.texture);
 			}
+			have = want;
 		}
 
 		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
-
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
+		if (pipeline.index_type != 0) {
+			GLsizei index_size = (pipeline.index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+			glDrawElementsBaseVertex(pipeline.type, pipeline.count, pipeline.index_type, (GLbyte *)0 + pipeline.start * index_size, pipeline.base_vertex);
+		} else {
+			glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
 		}
-		glActiveTexture(GL_TEXTURE0);
+	}
 
+	//un-bind textures:
+	for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+		if (current_textures[i].texture != 0) {
+			active_texture(i);
+			glBindTexture(current_textures[i].target, 0);
+		}
 	}
+	active_texture(0);
 
 	glUseProgram(0);
 	glBindVertexArray(0);
@@ -167,12 +308,13 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 
 
 void Scene::load(std::string const &filename,
-	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+	std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable) {
 
-	std::ifstream file(filename, std::ios::binary);
+	//chunks are used in place, straight out of the file mapping:
+	MappedFile file(filename);
+	ChunkReader reader(file.data, file.size);
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	ChunkSpan< char > names = reader.read_chunk< char >("str0");
 
 	struct HierarchyEntry {
 		uint32_t parent;
@@ -183,8 +325,7 @@ void Scene::load(std::string const &filename,
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
+	ChunkSpan< HierarchyEntry > hierarchy = reader.read_chunk< HierarchyEntry >("xfh0");
 
 	struct MeshEntry {
 		uint32_t transform;
@@ -192,8 +333,7 @@ void Scene::load(std::string const &filename,
 		uint32_t name_end;
 	};
 	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
+	ChunkSpan< MeshEntry > meshes = reader.read_chunk< MeshEntry >("msh0");
 
 	struct CameraEntry {
 		uint32_t transform;
@@ -202,8 +342,7 @@ void Scene::load(std::string const &filename,
 		float clip_near, clip_far;
 	};
 	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > loaded_cameras;
-	read_chunk(file, "cam0", &loaded_cameras);
+	ChunkSpan< CameraEntry > loaded_cameras = reader.read_chunk< CameraEntry >("cam0");
 
 	struct LightEntry {
 		uint32_t transform;
@@ -214,8 +353,7 @@ void Scene::load(std::string const &filename,
 		float fov;
 	};
 	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > loaded_lights;
-	read_chunk(file, "lmp0", &loaded_lights);
+	ChunkSpan< LightEntry > loaded_lights = reader.read_chunk< LightEntry >("lmp0");
 
 
 	//--------------------------------
@@ -255,10 +393,9 @@ void Scene::load(std::string const &filename,
 		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
 		}
-		std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
-
 		if (on_drawable) {
-			on_drawable(*this, hierarchy_transforms[m.transform], name);
+			//(the name points into the file mapping, so no string needs to be built)
+			on_drawable(*this, hierarchy_transforms[m.transform], std::string_view(names.begin() + m.name_begin, m.name_end - m.name_begin));
 		}
 
 	}
@@ -302,9 +439,9 @@ void Scene::load(std::string const &filename,
 	}
 
 	//load any extra that a subclass wants:
-	load_extra(file, names, hierarchy_transforms);
+	load_extra(reader, names, hierarchy_transforms);
 
-	if (file.peek() != EOF) {
+	if (!reader.at_end()) {
 		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
 	}
 
@@ -314,7 +451,7 @@ void Scene::load(std::string const &filename,
 
 //-------------------------
 
-Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable) {
 	load(filename, on_drawable);
 }
 
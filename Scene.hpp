@@ -11,6 +11,7 @@
  */
 
 #include "GL.hpp"
+#include "read_write_chunk.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -19,9 +20,12 @@
 #include <memory>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
+struct Mesh; //(see Mesh.hpp)
+
 struct Scene {
 	struct Transform {
 		//Transform names are useful for debugging and looking up locations in a loaded scene:
@@ -43,6 +47,21 @@ struct Scene {
 		glm::mat4x3 make_local_to_world() const;
 		glm::mat4x3 make_world_to_local() const;
 
+		//Cached versions of the above, refreshed by Scene::update_transforms():
+		// (only recomputed for transforms whose position/rotation/scale/parent changed, or whose parent's world matrix changed)
+		mutable glm::mat4x3 local_to_parent = glm::mat4x3(1.0f);
+		mutable glm::mat4x3 local_to_world = glm::mat4x3(1.0f);
+		//what the cached matrices were computed from:
+		mutable struct {
+			bool valid = false;
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+			Transform const *parent;
+			uint32_t changed = 0; //update_transforms() pass that last changed local_to_world
+			uint32_t ordered = 0; //update_transforms() pass that last put this transform in order
+		} cached;
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -65,6 +84,19 @@ struct Scene {
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
+			//indexed meshes are drawn with glDrawElementsBaseVertex instead:
+			GLenum index_type = 0; //type of indices in the vao's element buffer (zero to use glDrawArrays)
+			GLint base_vertex = 0; //added to each index
+			//...in which case 'start' and 'count' refer to indices
+
+			//vertex positions are mapped into object space by (position_offset + position_scale * Position):
+			// (for quantized meshes)
+			glm::vec3 position_scale = glm::vec3(1.0f);
+			glm::vec3 position_offset = glm::vec3(0.0f);
+
+			//copy the fields above from a Mesh:
+			void set_mesh(Mesh const &mesh);
+
 			//uniforms:
 			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
@@ -122,32 +154,63 @@ struct Scene {
 	std::list< Camera > cameras;
 	std::list< Light > lights;
 
+	//Bring every transform's cached local_to_world up to date:
+	// (walks the transforms once, parents before children; called by draw)
+	void update_transforms() const;
+
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
+	// (drawables are sorted by program, vertex array, texture, and depth -- so draw order is not list order --
+	//  and only state that changes between consecutive drawables is re-bound)
 	void draw(Camera const &camera) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//..or to draw pipelines that aren't in a Scene at all (e.g., from a FlatScene), each with its own object-to-world matrix:
+	struct DrawItem {
+		Drawable::Pipeline const *pipeline;
+		glm::mat4x3 const *object_to_world;
+	};
+	// (draw_items sorts them into 'queue', which the caller keeps between calls so it doesn't need to be re-allocated every frame)
+	struct QueuedItem {
+		uint64_t key;
+		uint32_t index; //(tie-breaker, so the order is stable)
+		DrawItem item;
+		bool operator<(QueuedItem const &o) const { return key != o.key ? key < o.key : index < o.index; }
+	};
+	static void draw_items(std::vector< DrawItem > const &items, std::vector< QueuedItem > *queue, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f));
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
+	// (the mesh name it is passed is only valid during the call; MeshBuffer::lookup takes it as-is)
 	// throws on file format errors
 	void load(std::string const &filename,
-		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
+		std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable = nullptr
 	);
 
 	//this function is called to read extra chunks from the scene file after the main chunks are read:
 	// this is useful if you, e.g., subclassing scene to represent a game level/area
-	virtual void load_extra(std::istream &from, std::vector< char > const &str0, std::vector< Transform * > const &xfh0) { }
+	// (chunks come straight from the file mapping, which lasts until load() returns)
+	virtual void load_extra(ChunkReader &from, ChunkSpan< char > const &str0, std::vector< Transform * > const &xfh0) { }
 
 	//empty scene:
 	Scene() = default;
 
 	//load a scene:
-	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
+	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable);
 
 	//copy a scene (with proper pointer fixup):
 	Scene(Scene const &); //...as a constructor
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
+
+	//internals:
+	//scratch space for update_transforms() and draw(), kept between calls so it doesn't need to be re-allocated every frame:
+	// (so a scene can only be updated / drawn from one thread at a time, but different scenes are independent)
+	mutable uint32_t update_pass = 0; //each update_transforms() pass gets a new number, so "changed this pass" is just a comparison
+	mutable std::vector< Transform const * > update_order;
+	mutable std::vector< Transform const * > update_chain;
+	mutable std::vector< DrawItem > draw_list;
+	mutable std::vector< QueuedItem > draw_queue;
 };
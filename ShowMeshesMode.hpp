@@ -31,11 +31,13 @@ struct ShowMeshesMode : Mode {
 	MeshBuffer const &buffer;
 
 	//currently selected mesh:
+	uint32_t current_mesh = -1U; //index in buffer.meshes
 	std::string current_mesh_name = "";
 	glm::vec3 current_mesh_min = glm::vec3(0.0f);
 	glm::vec3 current_mesh_max = glm::vec3(0.0f);
 	void select_prev_mesh();
 	void select_next_mesh();
+	void show_current_mesh(); //(updates the above from current_mesh)
 	
 	//Vertex array object used to bind mesh buffer for drawing:
 	GLuint vao = 0;
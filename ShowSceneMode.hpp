@@ -9,6 +9,7 @@
 
 #include "Mode.hpp"
 #include "Scene.hpp"
+#include "FlatScene.hpp"
 #include "Mesh.hpp"
 
 struct ShowSceneMode : Mode {
@@ -29,6 +30,8 @@ struct ShowSceneMode : Mode {
 
 	//Scene being viewed:
 	Scene const &scene;
+	//..flattened for drawing (the viewer never edits the scene, so this is made once):
+	FlatScene flat;
 
 	//mode uses a secondary Scene to hold a camera:
 	Scene camera_scene;
@@ -0,0 +1,267 @@
+#include "Solver.hpp"
+#include "Zobrist.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+Solver::State::State(Player const &player) {
+	auto card = [](std::tuple< int, int, int, int > const &c) {
+		return uint8_t(std::get<0>(c) * 13 + std::get<1>(c));
+	};
+
+	//(piles are copied top-aligned, in case any are somehow over capacity)
+	auto copy_pile = [&](std::vector< std::tuple< int, int, int, int > > const &from, uint8_t *to, uint8_t *count, uint32_t capacity) {
+		uint32_t skip = uint32_t(from.size()) > capacity ? uint32_t(from.size()) - capacity : 0;
+		*count = uint8_t(from.size() - skip);
+		for (uint32_t i = 0; i < *count; ++i) {
+			to[i] = card(from[skip + i]);
+		}
+	};
+
+	copy_pile(player.pos_pile, pos, &pos_count, 52);
+	//same value as Player, including -1 once flipping has emptied the pile:
+	assert(player.pos_pos >= -1 && player.pos_pos < std::max(1, int(pos_count)));
+	pos_pos = int8_t(player.pos_pos);
+	copy_pile(player.neg_pile, neg, &neg_count, 13);
+	copy_pile(player.one, active[0], &active_count[0], 13);
+	copy_pile(player.two, active[1], &active_count[1], 13);
+	copy_pile(player.three, active[2], &active_count[2], 13);
+	copy_pile(player.four, active[3], &active_count[3], 13);
+	suit_rank[0] = int8_t(std::get<1>(player.D));
+	suit_rank[1] = int8_t(std::get<1>(player.H));
+	suit_rank[2] = int8_t(std::get<1>(player.C));
+	suit_rank[3] = int8_t(std::get<1>(player.S));
+	score = uint8_t(player.score);
+
+	hash = compute_hash();
+}
+
+uint64_t Solver::State::compute_hash() const {
+	uint64_t h = 0;
+	for (uint32_t i = 0; i < pos_count; ++i) {
+		h ^= Zobrist::card(0, i, pos[i]);
+	}
+	for (uint32_t i = 0; i < neg_count; ++i) {
+		h ^= Zobrist::card(1, i, neg[i]);
+	}
+	for (uint32_t a = 0; a < 4; ++a) {
+		for (uint32_t i = 0; i < active_count[a]; ++i) {
+			h ^= Zobrist::card(2 + a, i, active[a][i]);
+		}
+	}
+	for (uint32_t suit = 0; suit < 4; ++suit) {
+		h ^= Zobrist::suit(suit, suit_rank[suit]);
+	}
+	h ^= Zobrist::pos_pos(pos_pos);
+	return h;
+}
+
+//-----------------------------------------
+
+//pos_pos after a flip (mirrors Player::flip):
+static int8_t flipped_pos_pos(Solver::State const &state) {
+	int32_t p = state.pos_pos + 3;
+	if (p >= state.pos_count) p = 3;
+	if (p >= state.pos_count) p = state.pos_count - 1;
+	return int8_t(p);
+}
+
+//card on top of pile 'from' (0-5); pile must be non-empty:
+static uint8_t top_card(Solver::State const &state, uint32_t from) {
+	if (from == 0) return state.pos[state.pos_pos];
+	else if (from == 1) return state.neg[state.neg_count - 1];
+	else return state.active[from - 2][state.active_count[from - 2] - 1];
+}
+
+uint32_t Solver::generate_moves(State const &state, Move *moves) {
+	assert(moves);
+	uint32_t count = 0;
+
+	//emptying the neg pile ends the game:
+	if (state.neg_count == 0) return 0;
+
+	bool has_card[6];
+	has_card[0] = (state.pos_pos >= 0 && state.pos_pos < state.pos_count);
+	has_card[1] = (state.neg_count > 0);
+	for (uint32_t a = 0; a < 4; ++a) {
+		has_card[2 + a] = (state.active_count[a] > 0);
+	}
+
+	//suit piles first:
+	for (uint32_t from = 0; from < 6; ++from) {
+		if (!has_card[from]) continue;
+		uint8_t card = top_card(state, from);
+		int suit = card / 13, rank = card % 13;
+		if (stacks_on_suit(suit, state.suit_rank[suit], suit, rank)) {
+			moves[count].from = uint8_t(from);
+			moves[count].to = uint8_t(6 + suit);
+			++count;
+		}
+	}
+
+	//then active piles:
+	for (uint32_t from = 0; from < 6; ++from) {
+		if (!has_card[from]) continue;
+		uint8_t card = top_card(state, from);
+		for (uint32_t a = 0; a < 4; ++a) {
+			if (from == 2 + a) continue;
+			bool fits;
+			if (state.active_count[a] == 0) {
+				fits = true;
+			} else {
+				uint8_t top = state.active[a][state.active_count[a] - 1];
+				fits = stacks_on_active(top / 13, top % 13, card / 13, card % 13);
+			}
+			if (fits) {
+				moves[count].from = uint8_t(from);
+				moves[count].to = uint8_t(2 + a);
+				++count;
+			}
+		}
+	}
+
+	//flipping only counts as a move if it changes which card is available:
+	if (state.pos_count > 0 && flipped_pos_pos(state) != state.pos_pos) {
+		moves[count] = Move();
+		++count;
+	}
+
+	assert(count <= MaxMoves);
+	return count;
+}
+
+void Solver::generate_moves(Player const &player, std::vector< Move > *moves_) {
+	assert(moves_);
+	auto &moves = *moves_;
+	moves.resize(MaxMoves);
+	moves.resize(generate_moves(State(player), moves.data()));
+}
+
+void Solver::apply(State &state, Move move) {
+	if (move.from == Move::Flip) {
+		state.hash ^= Zobrist::pos_pos(state.pos_pos);
+		state.pos_pos = flipped_pos_pos(state);
+		state.hash ^= Zobrist::pos_pos(state.pos_pos);
+		return;
+	}
+
+	uint8_t card = top_card(state, move.from);
+
+	if (move.to >= 6) {
+		uint32_t suit = card / 13;
+		assert(uint32_t(move.to - 6) == suit);
+		state.hash ^= Zobrist::suit(suit, state.suit_rank[suit]);
+		state.suit_rank[suit] = int8_t(card % 13);
+		state.hash ^= Zobrist::suit(suit, state.suit_rank[suit]);
+		state.score += 1;
+	} else {
+		assert(move.to >= 2);
+		uint32_t a = move.to - 2;
+		assert(state.active_count[a] < 13);
+		state.hash ^= Zobrist::card(move.to, state.active_count[a], card);
+		state.active[a][state.active_count[a]++] = card;
+	}
+
+	if (move.from == 0) {
+		//cards above the removed one shift down, so their keys change:
+		for (uint32_t i = state.pos_pos; i < state.pos_count; ++i) {
+			state.hash ^= Zobrist::card(0, i, state.pos[i]);
+		}
+		std::memmove(state.pos + state.pos_pos, state.pos + state.pos_pos + 1, state.pos_count - state.pos_pos - 1);
+		state.pos_count -= 1;
+		for (uint32_t i = state.pos_pos; i < state.pos_count; ++i) {
+			state.hash ^= Zobrist::card(0, i, state.pos[i]);
+		}
+		if (state.pos_pos != 0) {
+			state.hash ^= Zobrist::pos_pos(state.pos_pos);
+			state.pos_pos -= 1;
+			state.hash ^= Zobrist::pos_pos(state.pos_pos);
+		}
+	} else if (move.from == 1) {
+		state.neg_count -= 1;
+		state.hash ^= Zobrist::card(1, state.neg_count, state.neg[state.neg_count]);
+	} else {
+		uint32_t a = move.from - 2;
+		state.active_count[a] -= 1;
+		state.hash ^= Zobrist::card(move.from, state.active_count[a], state.active[a][state.active_count[a]]);
+	}
+}
+
+int32_t Solver::evaluate(State const &state) {
+	//points matter most; getting rid of neg pile cards breaks ties:
+	return 4 * int32_t(state.score) - int32_t(state.neg_count);
+}
+
+//-----------------------------------------
+
+Solver::Solver(uint32_t table_bits) : table(size_t(1) << table_bits), table_mask((uint64_t(1) << table_bits) - 1) {
+}
+
+//moves that are legal but can't lead anywhere new:
+static bool is_pointless(Solver::State const &state, Solver::Move move) {
+	if (move.from == Solver::Move::Flip || move.to >= 6) return false;
+	uint32_t a = move.to - 2;
+	if (state.active_count[a] != 0) return false;
+	//moving a lone active card to an empty pile changes nothing:
+	if (move.from >= 2 && state.active_count[move.from - 2] == 1) return true;
+	//all empty piles are alike, so only try the first:
+	for (uint32_t b = 0; b < a; ++b) {
+		if (state.active_count[b] == 0) return true;
+	}
+	return false;
+}
+
+int32_t Solver::search(State const &state, uint32_t depth) {
+	positions += 1;
+
+	//the player may always stop moving, so a position is worth at least its own value:
+	int32_t best = evaluate(state);
+	if (depth == 0) return best;
+
+	uint64_t key = state.hash;
+	Entry &entry = table[key & table_mask];
+	if (entry.key == key && entry.depth >= depth + 1) {
+		return entry.value;
+	}
+
+	Move moves[MaxMoves];
+	uint32_t count = generate_moves(state, moves);
+	for (uint32_t m = 0; m < count; ++m) {
+		if (is_pointless(state, moves[m])) continue;
+		State next = state;
+		apply(next, moves[m]);
+		best = std::max(best, search(next, depth - 1));
+	}
+
+	entry.key = key;
+	entry.value = best;
+	entry.depth = uint8_t(std::min< uint32_t >(depth + 1, 255));
+
+	return best;
+}
+
+bool Solver::best_move(State const &state, uint32_t depth, Move *move) {
+	assert(move);
+	bool found = false;
+	Move best;
+	int32_t best_value = std::numeric_limits< int32_t >::min();
+
+	Move moves[MaxMoves];
+	uint32_t count = generate_moves(state, moves);
+	for (uint32_t m = 0; m < count; ++m) {
+		if (is_pointless(state, moves[m])) continue;
+		State next = state;
+		apply(next, moves[m]);
+		int32_t value = search(next, depth > 0 ? depth - 1 : 0);
+		if (!found || value > best_value) {
+			found = true;
+			best_value = value;
+			best = moves[m];
+		}
+	}
+
+	if (found) *move = best;
+	return found;
+}
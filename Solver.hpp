@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+ * Move generation and a depth-limited search over one player's piles.
+ *
+ * Used for hints (PlayMode) and for bots that play a seat without a client.
+ *
+ * Search works on Solver::State, a fixed-size copy of a Player's piles
+ *  that is cheap to copy and apply moves to, and that carries an incrementally
+ *  updated Zobrist hash (Zobrist.hpp) for the transposition table. Moves use the same pile
+ *  numbers as Player::first / Player::second and Player::move_card.
+ *
+ */
+
+#include "Game.hpp"
+
+#include <vector>
+#include <cstdint>
+
+struct Solver {
+	struct Move {
+		//top card of 'from' (0-5) goes on 'to' (2-9); or from == to == Flip for Player::flip:
+		enum : uint8_t { Flip = 0xff };
+		uint8_t from = Flip;
+		uint8_t to = Flip;
+	};
+
+	//enough for every (from, to) pair plus a flip:
+	static constexpr uint32_t MaxMoves = 6 * 8 + 1;
+
+	struct State {
+		//cards are suit * 13 + rank:
+		uint8_t pos[52];
+		uint8_t pos_count = 0;
+		int8_t pos_pos = 0; //(-1 when empty, as in Player)
+		uint8_t neg[13];
+		uint8_t neg_count = 0;
+		uint8_t active[4][13]; //(active piles only ever build down, so never hold more than 13)
+		uint8_t active_count[4] = {0, 0, 0, 0};
+		int8_t suit_rank[4] = {-1, -1, -1, -1}; //rank of top card of the D, H, C, S piles
+		uint8_t score = 0;
+
+		//Zobrist hash, kept up to date by apply() (equal to Player::hash for the same piles):
+		uint64_t hash = 0;
+		uint64_t compute_hash() const;
+
+		//copy a player's piles:
+		State() = default;
+		explicit State(Player const &player);
+	};
+
+	//all legal moves in 'state', written to 'moves'; returns the count:
+	// (suit pile moves are listed first, since they score)
+	static uint32_t generate_moves(State const &state, Move *moves);
+	//same, for a player (clears 'moves' first):
+	static void generate_moves(Player const &player, std::vector< Move > *moves);
+
+	//apply a move returned by generate_moves:
+	static void apply(State &state, Move move);
+
+	//heuristic value of a position (higher is better):
+	static int32_t evaluate(State const &state);
+
+	//depth-limited search; stores the first move of the best line found in *move:
+	// (returns false, leaving *move alone, if there are no moves or they are all pointless)
+	bool best_move(State const &state, uint32_t depth, Move *move);
+	bool best_move(Player const &player, uint32_t depth, Move *move) { return best_move(State(player), depth, move); }
+
+	//counts positions visited by best_move (not reset between calls):
+	uint64_t positions = 0;
+
+	//transposition table size is 2^table_bits entries:
+	Solver(uint32_t table_bits = 20);
+
+	//internals:
+	struct Entry {
+		uint64_t key = 0;
+		int32_t value = 0;
+		uint8_t depth = 0; //n.b. zero marks an empty entry, so depths stored are remaining + 1
+	};
+	std::vector< Entry > table;
+	uint64_t table_mask;
+	int32_t search(State const &state, uint32_t depth);
+};
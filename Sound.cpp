@@ -4,12 +4,19 @@
 
 #include <SDL.h>
 
-#include <list>
+#include <atomic>
+#include <array>
 #include <cassert>
+#include <cstddef>
 #include <exception>
 #include <iostream>
 #include <algorithm>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SOUND_MIX_SSE
+#endif
+
 //local (to this file) data used by the audio system:
 namespace {
 
@@ -20,9 +27,183 @@ namespace {
 	//The audio device:
 	SDL_AudioDeviceID device = 0;
 
-	//list of all currently playing samples:
-	std::list< std::shared_ptr< Sound::PlayingSample > > playing_samples;
+	//currently playing samples (only touched by the audio callback); n.b. order isn't kept:
+	// (a few slots past MaxVoices let voices that lost out to new samples fade out instead of clicking off)
+	constexpr uint32_t const VOICE_SLOTS = Sound::MaxVoices + 4;
+	std::array< std::shared_ptr< Sound::PlayingSample >, VOICE_SLOTS > voices;
+	uint32_t voice_count = 0;
+	uint32_t voices_started = 0; //counts Play commands, for PlayingSample::started
+
+	//storage for PlayingSamples (plus their shared_ptr control blocks), so play() doesn't touch the heap:
+	// blocks are only taken by the game thread but may be given back by either thread (whichever drops
+	// the last reference), so free blocks are kept on a lock-free stack; with a single popper, a block
+	// can't be popped and pushed back between a pop's load and its compare-exchange, so there's no ABA problem.
+	constexpr uint32_t const POOL_BLOCKS = 8 * Sound::MaxVoices; //voices + handles the game holds on to + samples still in the command ring
+	constexpr size_t const POOL_BLOCK_SIZE = 256;
+	struct PoolBlock {
+		alignas(std::max_align_t) unsigned char bytes[POOL_BLOCK_SIZE];
+		PoolBlock *next = nullptr; //(when free)
+	};
+	PoolBlock pool[POOL_BLOCKS];
+	uint32_t pool_used = 0; //blocks [pool_used, POOL_BLOCKS) have never been handed out (game thread only)
+	std::atomic< PoolBlock * > pool_free(nullptr);
+
+	//std::allocate_shared-compatible allocator that uses the pool:
+	template< typename T >
+	struct PoolAllocator {
+		using value_type = T;
+		PoolAllocator() = default;
+		template< typename U >
+		PoolAllocator(PoolAllocator< U > const &) { }
+		T *allocate(size_t n);
+		void deallocate(T *p, size_t n);
+		template< typename U >
+		bool operator==(PoolAllocator< U > const &) const { return true; }
+		template< typename U >
+		bool operator!=(PoolAllocator< U > const &) const { return false; }
+	};
+
+	//changes requested by the game thread, applied by the audio callback at the start of each mix:
+	struct Command {
+		enum Type : uint8_t {
+			Play, //give 'sample' a voice
+			Volume, Pan, Position, HalfVolumeRadius, Stop, //change 'sample' (value in 'a.x' or 'a')
+			StopAll,
+			GlobalVolume, //value in 'a.x'
+			ListenerPositionRight, //position in 'a', right in 'b'
+		} type = Play;
+		std::shared_ptr< Sound::PlayingSample > sample;
+		glm::vec3 a = glm::vec3(0.0f);
+		glm::vec3 b = glm::vec3(0.0f);
+		float ramp = 0.0f;
+	};
+
+	//single-producer (game thread), single-consumer (audio callback) ring of commands:
+	// head is only written by the producer and tail only by the consumer, so neither side ever waits for the other
+	constexpr uint32_t const COMMAND_RING_SIZE = 1024; //n.b. must be a power of two
+	Command command_ring[COMMAND_RING_SIZE];
+	std::atomic< uint32_t > command_head(0); //next slot to write
+	std::atomic< uint32_t > command_tail(0); //next slot to read
+	uint32_t command_reclaimed = 0; //slots before this have had their references dropped (game thread only)
+
+	//references the audio callback is done with, handed back so that only the game thread ever drops them:
+	// (dropping the last reference to a stream frees its buffers and joins its decoding thread, which the audio thread must never wait on)
+	// single-producer (audio callback), single-consumer (game thread, in push_command)
+	constexpr uint32_t const RELEASE_RING_SIZE = 2048; //n.b. must be a power of two
+	std::shared_ptr< Sound::PlayingSample > release_ring[RELEASE_RING_SIZE];
+	std::atomic< uint32_t > release_head(0); //next slot to write
+	std::atomic< uint32_t > release_tail(0); //next slot to read
+
+	//every Stream that exists, so Sound::shutdown() can stop them (game thread only):
+	Sound::Stream *streams = nullptr;
+
+}
+
+//These helpers (defined below) apply commands on the audio thread:
+void apply_command(Command &command);
+void drain_commands();
+
+//take a block from the pool (game thread only):
+void *pool_allocate() {
+	PoolBlock *block = pool_free.load(std::memory_order_acquire);
+	while (block && !pool_free.compare_exchange_weak(block, block->next, std::memory_order_acquire, std::memory_order_acquire)) {
+		//(block was reloaded by the failed compare-exchange)
+	}
+	if (block) return block->bytes;
+	if (pool_used < POOL_BLOCKS) return pool[pool_used++].bytes;
+
+	//pool is exhausted (probably lots of handles are being held on to), so fall back to the heap:
+	static bool warned = false;
+	if (!warned) {
+		std::cerr << "WARNING: more than " << POOL_BLOCKS << " PlayingSamples alive at once; allocating extras from the heap." << std::endl;
+		warned = true;
+	}
+	return ::operator new(POOL_BLOCK_SIZE);
+}
+
+//return a block to the pool (any thread):
+void pool_deallocate(void *bytes) {
+	PoolBlock *block = reinterpret_cast< PoolBlock * >(bytes); //(bytes is the first member)
+	if (block < pool || block >= pool + POOL_BLOCKS) {
+		::operator delete(bytes);
+		return;
+	}
+	block->next = pool_free.load(std::memory_order_relaxed);
+	while (!pool_free.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+		//(block->next was reloaded by the failed compare-exchange)
+	}
+}
+
+template< typename T >
+T *PoolAllocator< T >::allocate(size_t n) {
+	static_assert(sizeof(T) <= POOL_BLOCK_SIZE, "PlayingSample should fit in a pool block.");
+	static_assert(alignof(T) <= alignof(std::max_align_t), "PlayingSample should not need extra alignment.");
+	assert(n == 1);
+	return reinterpret_cast< T * >(pool_allocate());
+}
+
+template< typename T >
+void PoolAllocator< T >::deallocate(T *p, size_t n) {
+	assert(n == 1);
+	pool_deallocate(p);
+}
+
+//hand a reference back to the game thread instead of dropping it (only ever called by the consumer):
+void release_sample(std::shared_ptr< Sound::PlayingSample > &&playing_sample) {
+	//between two calls to release_returned() the consumer can only let go of the voices it had plus the samples
+	// queued in the command ring, so the release ring never fills up:
+	static_assert(VOICE_SLOTS + COMMAND_RING_SIZE <= RELEASE_RING_SIZE, "release ring holds everything the consumer may let go of");
+	uint32_t head = release_head.load(std::memory_order_relaxed);
+	assert(head - release_tail.load(std::memory_order_acquire) < RELEASE_RING_SIZE);
+	release_ring[head & (RELEASE_RING_SIZE - 1)] = std::move(playing_sample);
+	release_head.store(head + 1, std::memory_order_release);
+}
+
+//drop references handed back by the consumer, along with those held by commands it has applied (game thread only):
+void release_returned() {
+	uint32_t tail = release_tail.load(std::memory_order_relaxed);
+	uint32_t head = release_head.load(std::memory_order_acquire);
+	while (tail != head) {
+		release_ring[tail & (RELEASE_RING_SIZE - 1)].reset();
+		++tail;
+	}
+	release_tail.store(tail, std::memory_order_release);
+
+	uint32_t applied = command_tail.load(std::memory_order_acquire);
+	while (command_reclaimed != applied) {
+		command_ring[command_reclaimed & (COMMAND_RING_SIZE - 1)].sample.reset();
+		++command_reclaimed;
+	}
+}
+
+//queue a command for the audio callback:
+void push_command(Command &&command) {
+	release_returned();
+
+	if (device == 0) {
+		//no audio callback will ever drain the ring, so don't queue anything
+		// (that would keep PlayingSamples -- and their pool blocks -- alive for good):
+		if (command.type == Command::Play) {
+			command.sample->stopped = true; //(there is nothing to play it on)
+		} else {
+			apply_command(command); //(keeps, e.g., Sound::volume up to date)
+		}
+		return;
+	}
 
+	uint32_t head = command_head.load(std::memory_order_relaxed);
+	//(slots are only reused once reclaimed, so the game thread is the one to drop their old references)
+	if (head - command_reclaimed == COMMAND_RING_SIZE) {
+		//ring is full -- the audio callback isn't keeping up (or audio isn't running at all),
+		// so lock it out and play consumer from this thread instead:
+		Sound::lock();
+		drain_commands();
+		apply_command(command);
+		Sound::unlock();
+		return;
+	}
+	command_ring[head & (COMMAND_RING_SIZE - 1)] = std::move(command);
+	command_head.store(head + 1, std::memory_order_release);
 }
 
 //public-facing data:
@@ -88,6 +269,38 @@ void Sound::shutdown() {
 		SDL_CloseAudioDevice(device);
 		device = 0;
 	}
+
+	//the audio callback won't run again, so drop everything it was holding on to:
+	for (uint32_t v = 0; v < voice_count; ++v) {
+		voices[v]->stopped = true;
+		voices[v].reset();
+	}
+	voice_count = 0;
+	release_returned();
+	uint32_t head = command_head.load(std::memory_order_relaxed);
+	for (auto &command : command_ring) {
+		command.sample.reset();
+	}
+	command_tail.store(head, std::memory_order_relaxed);
+	command_reclaimed = head;
+
+	//...and stop the background work of any streams the game still holds:
+	for (Stream *stream = streams; stream; stream = stream->next) {
+		stream->stop();
+	}
+}
+
+
+Sound::Stream::Stream() {
+	next = streams;
+	if (next) next->prev = this;
+	streams = this;
+}
+
+Sound::Stream::~Stream() {
+	if (prev) prev->next = next;
+	else streams = next;
+	if (next) next->prev = prev;
 }
 
 
@@ -99,156 +312,355 @@ void Sound::unlock() {
 	if (device) SDL_UnlockAudioDevice(device);
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::play(Sample const &sample, float play_volume, float pan) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, false);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
+//helper: make a new PlayingSample (in the pool) and queue it to play:
+template< typename... Args >
+std::shared_ptr< Sound::PlayingSample > start_playing(int priority, Args&&... args) {
+	std::shared_ptr< Sound::PlayingSample > playing_sample = std::allocate_shared< Sound::PlayingSample >(PoolAllocator< Sound::PlayingSample >(), std::forward< Args >(args)...);
+	playing_sample->priority = priority; //(fine to set directly, since the audio thread hasn't seen it yet)
+
+	Command command;
+	command.type = Command::Play;
+	command.sample = playing_sample;
+	push_command(std::move(command));
 	return playing_sample;
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::play_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, false);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
-	return playing_sample;
+std::shared_ptr< Sound::PlayingSample > Sound::play(Sample const &sample, float play_volume, float pan, int priority) {
+	return start_playing(priority, sample, play_volume, pan, false);
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float play_volume, float pan) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, true);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
-	return playing_sample;
+std::shared_ptr< Sound::PlayingSample > Sound::play_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius, int priority) {
+	return start_playing(priority, sample, play_volume, position, half_volume_radius, false);
 }
 
+//streams have no sample data of their own:
+static std::vector< float > const no_data;
 
+Sound::PlayingSample::PlayingSample(std::shared_ptr< Stream > const &stream_, float volume_, float pan_)
+	: data(no_data), stream(stream_), volume(volume_), pan(pan_) {
+	assert(stream);
+}
 
-std::shared_ptr< Sound::PlayingSample > Sound::loop_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, true);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
-	return playing_sample;
+Sound::PlayingSample::PlayingSample(std::shared_ptr< Stream > const &stream_, float volume_, glm::vec3 const &position_, float half_volume_radius_)
+	: data(no_data), stream(stream_), volume(volume_), position(position_), half_volume_radius(half_volume_radius_) {
+	assert(stream);
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::play(std::shared_ptr< Stream > const &stream, float play_volume, float pan, int priority) {
+	return start_playing(priority, stream, play_volume, pan);
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::play_3D(std::shared_ptr< Stream > const &stream, float play_volume, glm::vec3 const &position, float half_volume_radius, int priority) {
+	return start_playing(priority, stream, play_volume, position, half_volume_radius);
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float play_volume, float pan, int priority) {
+	return start_playing(priority, sample, play_volume, pan, true);
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::loop_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius, int priority) {
+	return start_playing(priority, sample, play_volume, position, half_volume_radius, true);
 }
 
 
 void Sound::stop_all_samples() {
-	lock();
-	for (auto &s : playing_samples) {
-		s->stop();
-	}
-	unlock();
+	Command command;
+	command.type = Command::StopAll;
+	push_command(std::move(command));
 }
 
 void Sound::set_volume(float new_volume, float ramp) {
-	lock();
-	volume.set(new_volume, ramp);
-	unlock();
+	Command command;
+	command.type = Command::GlobalVolume;
+	command.a.x = new_volume;
+	command.ramp = ramp;
+	push_command(std::move(command));
 }
 
 //------------------
 
+//helper: queue a change to a playing sample:
+// (the command holds a reference, so the sample stays alive until the audio thread has seen it)
+void push_sample_command(Sound::PlayingSample *playing_sample, Command::Type type, glm::vec3 const &value, float ramp) {
+	Command command;
+	command.type = type;
+	command.sample = playing_sample->shared_from_this();
+	command.a = value;
+	command.ramp = ramp;
+	push_command(std::move(command));
+}
+
 void Sound::PlayingSample::set_volume(float new_volume, float ramp) {
-	Sound::lock();
-	if (!stopping) {
-		volume.set(new_volume, ramp);
-	}
-	Sound::unlock();
+	push_sample_command(this, Command::Volume, glm::vec3(new_volume, 0.0f, 0.0f), ramp);
 }
 
 void Sound::PlayingSample::set_pan(float new_pan, float ramp) {
-	if (!(pan.value == pan.value)) return; //ignore if not in '2D' mode
-	Sound::lock();
-	pan.set(new_pan, ramp);
-	Sound::unlock();
+	push_sample_command(this, Command::Pan, glm::vec3(new_pan, 0.0f, 0.0f), ramp);
 }
 
 void Sound::PlayingSample::set_position(glm::vec3 const &new_position, float ramp) {
-	if (pan.value == pan.value) return; //ignore if not in '3D' mode
-	Sound::lock();
-	position.set(new_position, ramp);
-	Sound::unlock();
+	push_sample_command(this, Command::Position, new_position, ramp);
 }
 
 void Sound::PlayingSample::set_half_volume_radius(float new_radius, float ramp) {
-	if (pan.value == pan.value) return; //ignore if not in '3D' mode
-	Sound::lock();
-	half_volume_radius.set(new_radius, ramp);
-	Sound::unlock();
+	push_sample_command(this, Command::HalfVolumeRadius, glm::vec3(new_radius, 0.0f, 0.0f), ramp);
 }
 
 void Sound::PlayingSample::stop(float ramp) {
-	Sound::lock();
-	if (!(stopping || stopped)) {
-		stopping = true;
-		volume.target = 0.0f;
-		volume.ramp = ramp;
-	} else {
-		volume.ramp = std::min(volume.ramp, ramp);
-	}
-	Sound::unlock();
+	push_sample_command(this, Command::Stop, glm::vec3(0.0f), ramp);
 }
 
 //------------------
 
 void Sound::Listener::set_position_right(glm::vec3 const &new_position, glm::vec3 const &new_right, float ramp) {
-	Sound::lock();
-	position.set(new_position, ramp);
+	Command command;
+	command.type = Command::ListenerPositionRight;
+	command.a = new_position;
 	//some extra code to make sure right is always a unit vector:
 	if (new_right == glm::vec3(0.0f)) {
-		right.set(glm::vec3(1.0f, 0.0f, 0.0f), ramp);
+		command.b = glm::vec3(1.0f, 0.0f, 0.0f);
 	} else {
-		right.set(glm::normalize(new_right), ramp);
+		command.b = glm::normalize(new_right);
 	}
-	Sound::unlock();
+	command.ramp = ramp;
+	push_command(std::move(command));
 }
 
 //------------------------ internals --------------------------------
 
 
-//helper: equal-power panning
-inline void compute_pan_weights(float pan, float *left, float *right) {
-	//clamp pan to -1 to 1 range:
-	pan = std::max(-1.0f, std::min(1.0f, pan));
-
-	//want left^2 + right^2 = 1.0, so use angles:
-	float ang = 0.5f * 3.1415926f * (0.5f * (pan + 1.0f));
-	*left = std::cos(ang);
-	*right = std::sin(ang);
-}
-
-//helper: 3D audio panning
-void compute_pan_from_listener_and_position(
-	glm::vec3 const &listener_position,
-	glm::vec3 const &listener_right,
-	glm::vec3 const &source_position,
-	float source_half_radius,
-	float *left, float *right
-	) {
-	glm::vec3 to = source_position - listener_position;
-	float distance = glm::length(to);
-	//start by panning based on direction.
-	//note that for a LR fade to sound uniform, sound power (squared magnitude) should remain constant.
-	if (distance == 0.0f) {
-		*left = *right = std::sqrt(2.0f);
+//helper: stop a playing sample (fade out over 'ramp' seconds):
+void stop_sample(Sound::PlayingSample &playing_sample, float ramp) {
+	if (!(playing_sample.stopping || playing_sample.stopped)) {
+		playing_sample.stopping = true;
+		playing_sample.volume.target = 0.0f;
+		playing_sample.volume.ramp = ramp;
 	} else {
+		playing_sample.volume.ramp = std::min(playing_sample.volume.ramp, ramp);
+	}
+}
+
+//helper: give a new sample a voice, taking one from a less important sample if they are all busy:
+void start_voice(std::shared_ptr< Sound::PlayingSample > &&playing_sample) {
+	playing_sample->started = voices_started++;
+	//(not mixed yet, so estimate its loudness from its volume until it is)
+	playing_sample->gain = playing_sample->volume.value * Sound::volume.value;
+
+	//is voice 'a' less worth keeping than voice 'b'?
+	// (lower priority, then quieter -- in 6dB steps, so similar volumes count as equal -- then older)
+	auto less_important = [](Sound::PlayingSample const &a, Sound::PlayingSample const &b) {
+		if (a.priority != b.priority) return a.priority < b.priority;
+		int a_level = (a.gain > 0.0f ? std::ilogb(a.gain) : std::numeric_limits< int >::min());
+		int b_level = (b.gain > 0.0f ? std::ilogb(b.gain) : std::numeric_limits< int >::min());
+		if (a_level != b_level) return a_level < b_level;
+		return int32_t(a.started - b.started) < 0;
+	};
+
+	//least important voice that is (or isn't) already fading out, or voice_count if there isn't one:
+	auto least_important = [&](bool stopping) {
+		uint32_t victim = voice_count;
+		for (uint32_t v = 0; v < voice_count; ++v) {
+			if (voices[v]->stopping != stopping) continue;
+			if (victim == voice_count || less_important(*voices[v], *voices[victim])) victim = v;
+		}
+		return victim;
+	};
+
+	uint32_t live = 0;
+	for (uint32_t v = 0; v < voice_count; ++v) {
+		if (!voices[v]->stopping) live += 1;
+	}
+
+	if (live == Sound::MaxVoices) {
+		uint32_t victim = least_important(false);
+		if (playing_sample->priority < voices[victim]->priority) {
+			//everything playing matters more than the new sample, so it doesn't play:
+			playing_sample->stopped = true;
+			return;
+		}
+		//(fades to zero over the next mix, rather than cutting off with a click)
+		stop_sample(*voices[victim], 0.0f);
+	}
+
+	if (voice_count < voices.size()) {
+		voices[voice_count++] = std::move(playing_sample);
+	} else {
+		//every slot is taken, so at least VOICE_SLOTS - MaxVoices voices are fading out; cut one off:
+		uint32_t victim = least_important(true);
+		assert(victim < voice_count);
+		voices[victim]->stopped = true;
+		release_sample(std::move(voices[victim]));
+		voices[victim] = std::move(playing_sample);
+	}
+}
+
+//apply a command from the game thread (on the audio thread, or with the audio thread locked out):
+void apply_command(Command &command) {
+	Sound::PlayingSample *playing_sample = command.sample.get();
+	//(2D samples have a non-NaN pan; 3D samples have NaN pan)
+	bool is_2D = playing_sample && playing_sample->pan.value == playing_sample->pan.value;
+	switch (command.type) {
+		case Command::Play:
+			assert(playing_sample);
+			start_voice(std::move(command.sample));
+			break;
+		case Command::Volume:
+			if (!playing_sample->stopping) playing_sample->volume.set(command.a.x, command.ramp);
+			break;
+		case Command::Pan:
+			if (is_2D) playing_sample->pan.set(command.a.x, command.ramp);
+			break;
+		case Command::Position:
+			if (!is_2D) playing_sample->position.set(command.a, command.ramp);
+			break;
+		case Command::HalfVolumeRadius:
+			if (!is_2D) playing_sample->half_volume_radius.set(command.a.x, command.ramp);
+			break;
+		case Command::Stop:
+			stop_sample(*playing_sample, command.ramp);
+			break;
+		case Command::StopAll:
+			for (uint32_t v = 0; v < voice_count; ++v) {
+				stop_sample(*voices[v], 1.0f / 60.0f);
+			}
+			break;
+		case Command::GlobalVolume:
+			Sound::volume.set(command.a.x, command.ramp);
+			break;
+		case Command::ListenerPositionRight:
+			Sound::listener.position.set(command.a, command.ramp);
+			Sound::listener.right.set(command.b, command.ramp);
+			break;
+	}
+}
+
+//apply every queued command (only ever called by the consumer):
+void drain_commands() {
+	uint32_t tail = command_tail.load(std::memory_order_relaxed);
+	uint32_t head = command_head.load(std::memory_order_acquire);
+	while (tail != head) {
+		Command &command = command_ring[tail & (COMMAND_RING_SIZE - 1)];
+		apply_command(command);
+		//(command.sample is left for the producer to drop, in release_returned)
+		++tail;
+	}
+	command_tail.store(tail, std::memory_order_release);
+}
+
+//per-voice panning inputs and outputs, as parallel arrays so that compute_pans can do four voices at a time:
+struct PanBatch {
+	//inputs:
+	alignas(16) float x[VOICE_SLOTS]; //3D position (unused by 2D voices)
+	alignas(16) float y[VOICE_SLOTS];
+	alignas(16) float z[VOICE_SLOTS];
+	alignas(16) float half_radius[VOICE_SLOTS]; //3D half-volume radius (unused by 2D voices)
+	alignas(16) float pan[VOICE_SLOTS]; //2D pan, or NaN for 3D voices
+	alignas(16) float volume[VOICE_SLOTS]; //global volume * sample volume
+	//outputs:
+	alignas(16) float l[VOICE_SLOTS];
+	alignas(16) float r[VOICE_SLOTS];
+
+	void set(uint32_t v, Sound::PlayingSample const &playing_sample, float global_volume) {
+		x[v] = playing_sample.position.value.x;
+		y[v] = playing_sample.position.value.y;
+		z[v] = playing_sample.position.value.z;
+		half_radius[v] = playing_sample.half_volume_radius.value;
+		pan[v] = playing_sample.pan.value;
+		volume[v] = global_volume * playing_sample.volume.value;
+	}
+};
+static_assert(VOICE_SLOTS % 4 == 0, "voices are panned four at a time");
+
+//helper: sin(x) for x in [0, pi/2], from its Taylor series up to x^7:
+// (off by less than 2e-4, which is inaudible in a gain; cos(x) is pan_sin(pi/2 - x))
+inline float pan_sin(float x) {
+	float x2 = x * x;
+	return x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f))));
+}
+
+//helper: compute left/right gains for the first 'count' voices in 'batch' (lanes past 'count' get garbage):
+// 2D voices use equal-power panning;
+// 3D voices pan by direction from the listener and are attenuated by distance.
+//  note that for a LR fade to sound uniform, sound power (squared magnitude) should remain constant.
+//  squared distance attenuation is realistic if there are no walls,
+//  but I'm going to use linear because it's sounds better to me.
+//  (feel free to change it, of course)
+void compute_pans(PanBatch &batch, uint32_t count, glm::vec3 const &listener_position, glm::vec3 const &listener_right) {
+	constexpr float const QuarterPi = 0.25f * 3.1415926f;
+	constexpr float const HalfPi = 0.5f * 3.1415926f;
+#ifdef SOUND_MIX_SSE
+	auto select = [](__m128 mask, __m128 a, __m128 b) { //mask ? a : b
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	};
+	auto sin4 = [](__m128 x) { //pan_sin, four at a time
+		__m128 x2 = _mm_mul_ps(x, x);
+		__m128 p = _mm_add_ps(_mm_set1_ps(1.0f / 120.0f), _mm_mul_ps(x2, _mm_set1_ps(-1.0f / 5040.0f)));
+		p = _mm_add_ps(_mm_set1_ps(-1.0f / 6.0f), _mm_mul_ps(x2, p));
+		p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, p));
+		return _mm_mul_ps(x, p);
+	};
+	__m128 const one = _mm_set1_ps(1.0f);
+	__m128 const lx = _mm_set1_ps(listener_position.x), ly = _mm_set1_ps(listener_position.y), lz = _mm_set1_ps(listener_position.z);
+	__m128 const rx = _mm_set1_ps(listener_right.x), ry = _mm_set1_ps(listener_right.y), rz = _mm_set1_ps(listener_right.z);
+	for (uint32_t v = 0; v < count; v += 4) {
+		__m128 tx = _mm_sub_ps(_mm_load_ps(batch.x + v), lx);
+		__m128 ty = _mm_sub_ps(_mm_load_ps(batch.y + v), ly);
+		__m128 tz = _mm_sub_ps(_mm_load_ps(batch.z + v), lz);
+		__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+		__m128 distance = _mm_sqrt_ps(distance2);
 		//amt ranges from -1 (most left) to 1 (most right):
-		float amt = glm::dot(listener_right, to) / distance;
-		//turn into an angle from 0.0f (most left) to pi/2 (most right):
-		float ang = 0.5f * 3.1415926f * (0.5f * (amt + 1.0f));
-		*left = std::cos(ang);
-		*right = std::sin(ang);
+		__m128 amt = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, tx), _mm_mul_ps(ry, ty)), _mm_mul_ps(rz, tz)), distance);
+		//want att = 0.5f at distance == half_volume_radius:
+		__m128 att = _mm_div_ps(one, _mm_add_ps(one, _mm_div_ps(distance, _mm_load_ps(batch.half_radius + v))));
 
-		//squared distance attenuation is realistic if there are no walls,
-		// but I'm going to use linear because it's sounds better to me.
-		// (feel free to change it, of course)
-		//want att = 0.5f at distance == half_volume_radius
-		float att = 1.0f / (1.0f + (distance / source_half_radius));
-		*left *= att;
-		*right *= att;
+		__m128 pan = _mm_load_ps(batch.pan + v);
+		__m128 is_2D = _mm_cmpeq_ps(pan, pan); //(NaN pan marks 3D voices)
+		amt = select(is_2D, pan, amt);
+		att = select(is_2D, one, att);
+		amt = _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(one, amt));
+
+		//turn into an angle from 0.0f (most left) to pi/2 (most right):
+		__m128 ang = _mm_mul_ps(_mm_set1_ps(QuarterPi), _mm_add_ps(amt, one));
+		__m128 l = _mm_mul_ps(sin4(_mm_sub_ps(_mm_set1_ps(HalfPi), ang)), att);
+		__m128 r = _mm_mul_ps(sin4(ang), att);
+
+		//3D sources right on top of the listener aren't panned (or attenuated):
+		__m128 on_top = _mm_andnot_ps(is_2D, _mm_cmpeq_ps(distance2, _mm_setzero_ps()));
+		l = select(on_top, _mm_set1_ps(std::sqrt(2.0f)), l);
+		r = select(on_top, _mm_set1_ps(std::sqrt(2.0f)), r);
+
+		__m128 volume = _mm_load_ps(batch.volume + v);
+		_mm_store_ps(batch.l + v, _mm_mul_ps(l, volume));
+		_mm_store_ps(batch.r + v, _mm_mul_ps(r, volume));
 	}
+#else
+	for (uint32_t v = 0; v < count; ++v) {
+		float amt, att;
+		if (batch.pan[v] == batch.pan[v]) {
+			//2D:
+			amt = batch.pan[v];
+			att = 1.0f;
+		} else {
+			//3D:
+			glm::vec3 to = glm::vec3(batch.x[v], batch.y[v], batch.z[v]) - listener_position;
+			float distance = glm::length(to);
+			if (distance == 0.0f) {
+				//sources right on top of the listener aren't panned (or attenuated):
+				batch.l[v] = batch.r[v] = std::sqrt(2.0f) * batch.volume[v];
+				continue;
+			}
+			//amt ranges from -1 (most left) to 1 (most right):
+			amt = glm::dot(listener_right, to) / distance;
+			//want att = 0.5f at distance == half_volume_radius:
+			att = 1.0f / (1.0f + (distance / batch.half_radius[v]));
+		}
+		amt = std::max(-1.0f, std::min(1.0f, amt));
+		//turn into an angle from 0.0f (most left) to pi/2 (most right):
+		float ang = QuarterPi * (amt + 1.0f);
+		batch.l[v] = pan_sin(HalfPi - ang) * att * batch.volume[v];
+		batch.r[v] = pan_sin(ang) * att * batch.volume[v];
+	}
+#endif
 }
 
 //helper: ramp updates...
@@ -310,18 +722,52 @@ void step_direction_ramp(Sound::Ramp< glm::vec3 > &ramp) {
 }
 
 
+//output samples are interleaved left/right pairs:
+struct LR {
+	float l;
+	float r;
+};
+static_assert(sizeof(LR) == 8, "Sample is packed");
+
+//helper: mix 'count' samples of 'data' into 'out', with gains ramping linearly from 'pan' by 'pan_step' per sample:
+// (the caller splits voices into runs that don't cross the end of their data, so there are no checks in here)
+void mix_run(LR *out, float const *data, uint32_t count, LR pan, LR pan_step) {
+	uint32_t i = 0;
+#ifdef SOUND_MIX_SSE
+	//four samples (eight output floats) at a time:
+	float *out_f = &out[0].l;
+	__m128 gain_lo = _mm_setr_ps(pan.l, pan.r, pan.l + pan_step.l, pan.r + pan_step.r); //gains for samples i, i+1
+	__m128 gain_hi = _mm_add_ps(gain_lo, _mm_setr_ps(2.0f * pan_step.l, 2.0f * pan_step.r, 2.0f * pan_step.l, 2.0f * pan_step.r)); //..for i+2, i+3
+	__m128 gain_step = _mm_setr_ps(4.0f * pan_step.l, 4.0f * pan_step.r, 4.0f * pan_step.l, 4.0f * pan_step.r);
+	for (; i + 4 <= count; i += 4) {
+		__m128 d = _mm_loadu_ps(data + i); //d0 d1 d2 d3
+		__m128 d_lo = _mm_unpacklo_ps(d, d); //d0 d0 d1 d1
+		__m128 d_hi = _mm_unpackhi_ps(d, d); //d2 d2 d3 d3
+		__m128 o_lo = _mm_loadu_ps(out_f + 2 * i);
+		__m128 o_hi = _mm_loadu_ps(out_f + 2 * i + 4);
+		_mm_storeu_ps(out_f + 2 * i, _mm_add_ps(o_lo, _mm_mul_ps(gain_lo, d_lo)));
+		_mm_storeu_ps(out_f + 2 * i + 4, _mm_add_ps(o_hi, _mm_mul_ps(gain_hi, d_hi)));
+		gain_lo = _mm_add_ps(gain_lo, gain_step);
+		gain_hi = _mm_add_ps(gain_hi, gain_step);
+	}
+#endif
+	//remaining samples (or all of them, without SSE):
+	for (; i < count; ++i) {
+		out[i].l += (pan.l + i * pan_step.l) * data[i];
+		out[i].r += (pan.r + i * pan_step.r) * data[i];
+	}
+}
+
 //The audio callback -- invoked by SDL when it needs more sound to play:
 void mix_audio(void *, Uint8 *buffer_, int len) {
 	assert(buffer_); //should always have some audio buffer
 
-	struct LR {
-		float l;
-		float r;
-	};
-	static_assert(sizeof(LR) == 8, "Sample is packed");
 	assert(len == MIX_SAMPLES * sizeof(LR)); //should always have the expected number of samples
 	LR *buffer = reinterpret_cast< LR * >(buffer_);
 
+	//pick up changes from the game thread:
+	drain_commands();
+
 	//zero the output buffer:
 	for (uint32_t s = 0; s < MIX_SAMPLES; ++s) {
 		buffer[s].l = 0.0f;
@@ -341,87 +787,87 @@ void mix_audio(void *, Uint8 *buffer_, int len) {
 	glm::vec3 end_position =  Sound::listener.position.value;
 	glm::vec3 end_right =  Sound::listener.right.value;
 
-	//add audio from each playing sample into the buffer:
-	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
-		Sound::PlayingSample &playing_sample = **si; //much more convenient than writing ** everywhere.
-
-		//Figure out sample panning/volume at start...
-		LR start_pan;
+	//gather each voice's panning inputs at the start and end of the mix period, stepping ramps in between...
+	static PanBatch start_pans, end_pans; //(static since they're a bit big for the stack; only the audio thread uses them)
+	for (uint32_t v = 0; v < voice_count; ++v) {
+		Sound::PlayingSample &playing_sample = *voices[v];
+		start_pans.set(v, playing_sample, start_volume);
 		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
 			//3D panning
-			compute_pan_from_listener_and_position(
-				start_position, start_right,
-				playing_sample.position.value,
-				playing_sample.half_volume_radius.value,
-				&start_pan.l, &start_pan.r);
-
 			step_position_ramp(playing_sample.position);
 			step_value_ramp(playing_sample.half_volume_radius);
 		} else {
 			//2D panning
-			compute_pan_weights(playing_sample.pan.value, &start_pan.l, &start_pan.r);
-
 			step_value_ramp(playing_sample.pan);
 		}
-		start_pan.l *= start_volume * playing_sample.volume.value;
-		start_pan.r *= start_volume * playing_sample.volume.value;
-
 		step_value_ramp(playing_sample.volume);
+		end_pans.set(v, playing_sample, end_volume);
+	}
 
-		//..and end of the mix period:
-		LR end_pan;
-		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
-			//3D panning
-			compute_pan_from_listener_and_position(
-				end_position, end_right,
-				playing_sample.position.value,
-				playing_sample.half_volume_radius.value,
-				&end_pan.l, &end_pan.r);
-		} else {
-			//2D panning
-			compute_pan_weights(playing_sample.pan.value, &end_pan.l, &end_pan.r);
-		}
+	//...and turn them into left/right gains for all voices at once:
+	compute_pans(start_pans, voice_count, start_position, start_right);
+	compute_pans(end_pans, voice_count, end_position, end_right);
 
-		end_pan.l *= end_volume * playing_sample.volume.value;
-		end_pan.r *= end_volume * playing_sample.volume.value;
+	//add audio from each playing sample into the buffer:
+	// (back to front, so a finished voice can be replaced by the last voice, which has already been mixed)
+	for (uint32_t v = voice_count; v-- > 0; ) {
+		Sound::PlayingSample &playing_sample = *voices[v]; //much more convenient than writing * everywhere.
+
+		LR start_pan;
+		start_pan.l = start_pans.l[v];
+		start_pan.r = start_pans.r[v];
+		LR end_pan;
+		end_pan.l = end_pans.l[v];
+		end_pan.r = end_pans.r[v];
+		playing_sample.gain = std::max(end_pan.l, end_pan.r);
 
 		//figure out a step to add at each sample so that pan will move smoothly from start to end:
-		LR pan = start_pan;
 		LR pan_step;
 		pan_step.l = (end_pan.l - start_pan.l) / MIX_SAMPLES;
 		pan_step.r = (end_pan.r - start_pan.r) / MIX_SAMPLES;
 
-		assert(playing_sample.i < playing_sample.data.size());
-
-		for (uint32_t i = 0; i < MIX_SAMPLES; ++i) {
-			//mix one sample based on current pan values:
-			buffer[i].l += pan.l * playing_sample.data[playing_sample.i];
-			buffer[i].r += pan.r * playing_sample.data[playing_sample.i];
-
-			//update position in sample:
-			playing_sample.i += 1;
-			if (playing_sample.i == playing_sample.data.size()) {
-				if (playing_sample.loop) {
-					playing_sample.i = 0;
-				} else {
-					break;
+		bool finished = false;
+		if (playing_sample.stream) {
+			//streams are read a block at a time into scratch space:
+			static float stream_data[MIX_SAMPLES];
+			uint32_t count = playing_sample.stream->read(stream_data, MIX_SAMPLES);
+			assert(count <= MIX_SAMPLES);
+			mix_run(buffer, stream_data, count, start_pan, pan_step);
+			//(a short read that isn't the end is an underrun; the rest of the block stays silent)
+			finished = (count < MIX_SAMPLES && playing_sample.stream->finished());
+		} else {
+			assert(playing_sample.i < playing_sample.data.size());
+
+			//mix in contiguous runs, stopping at the end of the sample data to loop (or finish):
+			for (uint32_t mixed = 0; mixed < MIX_SAMPLES; /* later */) {
+				uint32_t run = std::min(MIX_SAMPLES - mixed, uint32_t(playing_sample.data.size()) - playing_sample.i);
+				LR pan;
+				pan.l = start_pan.l + mixed * pan_step.l;
+				pan.r = start_pan.r + mixed * pan_step.r;
+				mix_run(buffer + mixed, playing_sample.data.data() + playing_sample.i, run, pan, pan_step);
+				mixed += run;
+
+				//update position in sample:
+				playing_sample.i += run;
+				if (playing_sample.i == playing_sample.data.size()) {
+					if (playing_sample.loop) {
+						playing_sample.i = 0;
+					} else {
+						break;
+					}
 				}
 			}
 
-			//update pan values:
-			pan.l += pan_step.l;
-			pan.r += pan_step.r;
+			finished = (playing_sample.i >= playing_sample.data.size());
 		}
 
-		if (playing_sample.i >= playing_sample.data.size()
+		if (finished
 		 || (playing_sample.stopping && playing_sample.volume.value == 0.0f)) { //sample has finished
 		 	playing_sample.stopped = true;
-			//erase from list:
-			auto old = si;
-			++si;
-			playing_samples.erase(old);
-		} else {
-			++si;
+			//free the voice by moving the last voice into its place:
+			release_sample(std::move(voices[v]));
+			voices[v] = std::move(voices[voice_count - 1]);
+			voice_count -= 1;
 		}
 	}
 
@@ -430,7 +876,7 @@ void mix_audio(void *, Uint8 *buffer_, int len) {
 	for (uint32_t s = 0; s < MIX_SAMPLES; ++s) {
 		max_power = std::max(max_power, (buffer[s].l * buffer[s].l + buffer[s].r * buffer[s].r));
 	}
-	std::cout << "Max Power: " << std::sqrt(max_power) << "; playing samples: " << playing_samples.size() << std::endl; //DEBUG
+	std::cout << "Max Power: " << std::sqrt(max_power) << "; playing samples: " << voice_count << std::endl; //DEBUG
 	*/
 
 }
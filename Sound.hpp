@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <string>
@@ -25,6 +26,28 @@ struct Sample {
 	std::vector< float > data;
 };
 
+//Stream objects supply mono 48kHz audio a block at a time, rather than holding it all in memory:
+// (e.g., OpusStream decodes long music files on a background thread as they play)
+// (streams are only ever destroyed on the game thread -- the audio thread hands its references back -- so destructors may block)
+struct Stream {
+	Stream(); //(streams are tracked, so Sound::shutdown() can stop them)
+	virtual ~Stream();
+	//called from the audio thread, so must not block:
+	// copy up to 'count' samples to 'out' and return how many were copied;
+	// returning fewer than 'count' is an underrun (the rest is played as silence), unless finished() is true:
+	virtual uint32_t read(float *out, uint32_t count) = 0;
+	//has the stream run out of data for good?
+	virtual bool finished() const = 0;
+	//stop any background work (e.g., a decoding thread) for good; called by Sound::shutdown() on streams still alive:
+	virtual void stop() { }
+
+	Stream(Stream const &) = delete;
+	Stream &operator=(Stream const &) = delete;
+
+	//internals:
+	Stream *prev = nullptr, *next = nullptr; //list of all streams
+};
+
 //Ramp<> manages values that should be smoothly interpolated
 //  to a target over a certain amount of time:
 template< typename T >
@@ -49,8 +72,8 @@ struct Ramp {
 };
 
 // 'PlayingSample' objects book-keep samples that are currently playing:
-struct PlayingSample {
-	//change the panning or volume of a playing sample (and do proper locking);
+struct PlayingSample : std::enable_shared_from_this< PlayingSample > {
+	//change the panning or volume of a playing sample (changes are queued for the audio thread, so these never block);
 	// value will change over 'ramp' seconds to avoid creating audible artifacts:
 	void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
 	//set the panning of a sample (use only on samples in "2D" mode; no effect on "3D" samples):
@@ -65,12 +88,16 @@ struct PlayingSample {
 
 	//internals:
 	//NOTE: PlayingSample is used in a separate thread; so setting these values directly
-	// may result in bad results. Instead, use the functions above, which perform locking!
-	std::vector< float > const &data; //reference to sample data being played
+	// may result in bad results. Instead, use the functions above, which queue changes for the audio thread!
+	std::vector< float > const &data; //reference to sample data being played (empty for streams)
+	std::shared_ptr< Stream > stream; //if set, audio is read from here instead of 'data'
 	uint32_t i = 0; //next data value to read
 	bool loop = false; //should playback loop after data runs out?
 	bool stopping = false; //is playing stopping?
-	bool stopped = false; //was playback stopped (either by running out of sample, or by stop())?
+	std::atomic< bool > stopped{false}; //was playback stopped (either by running out of sample, by stop(), or by losing its voice)? (safe to read from any thread)
+	int priority = 0; //when all voices are busy, higher priority samples take voices from lower priority ones
+	uint32_t started = 0; //when the sample got its voice (in order of Play commands)
+	float gain = 0.0f; //loudest channel gain as of the last mix (used to pick which voice to steal)
 
 	Ramp< float > volume = Ramp< float >(1.0f);
 
@@ -85,27 +112,38 @@ struct PlayingSample {
 		: data(sample_.data), loop(loop_), volume(volume_), pan(pan_) { }
 	PlayingSample(Sample const &sample_, float volume_, glm::vec3 const &position_, float half_volume_radius_, bool loop_)
 		: data(sample_.data), loop(loop_), volume(volume_), position(position_), half_volume_radius(half_volume_radius_) { }
+	PlayingSample(std::shared_ptr< Stream > const &stream_, float volume_, float pan_);
+	PlayingSample(std::shared_ptr< Stream > const &stream_, float volume_, glm::vec3 const &position_, float half_volume_radius_);
 };
 
 // ------- global functions -------
 
+//at most this many samples play at once; past that, play() takes the voice of the
+// least important playing sample (lower priority, then quieter, then older), or doesn't play at all if every
+// playing sample has a higher priority:
+constexpr uint32_t const MaxVoices = 32;
+
 void init(); //call Sound::init() from main.cpp before using any member functions
 
-void shutdown(); //call Sound::shutdown() from main.cpp to gracefully(-ish) exit
+void shutdown(); //call Sound::shutdown() from main.cpp to gracefully(-ish) exit (also stops any streams' background work)
 
 //Call 'Sound::play' to play a sample once.
 //  if you hang on to the return value, you can change the panning, volume, or stop playback early.
+//  (PlayingSamples come from a fixed pool, so playing a sound doesn't allocate; but handles you hang on to
+//   keep their pool slot, so let go of the ones you are done with)
 std::shared_ptr< PlayingSample > play(
 	Sample const &sample,
 	float volume = 1.0f,
-	float pan = 0.0f //-1.0f == hard left, 1.0f == hard right
+	float pan = 0.0f, //-1.0f == hard left, 1.0f == hard right
+	int priority = 0
 );
 //The play_3D version will play a sample in '3D' mode (that is, panning determined by listener position):
 std::shared_ptr< PlayingSample > play_3D(
 	Sample const &sample,
 	float volume,
 	glm::vec3 const &position,
-	float half_volume_radius = std::numeric_limits< float >::infinity()
+	float half_volume_radius = std::numeric_limits< float >::infinity(),
+	int priority = 0
 );
 
 //Call 'Sound::loop' to play a sample ~forever~.
@@ -113,14 +151,31 @@ std::shared_ptr< PlayingSample > play_3D(
 std::shared_ptr< PlayingSample > loop(
 	Sample const &sample,
 	float volume = 1.0f,
-	float pan = 0.0f //-1.0f == hard left, 1.0f == hard right
+	float pan = 0.0f, //-1.0f == hard left, 1.0f == hard right
+	int priority = 0
 );
 //The loop_3D version will loop a sample in '3D' mode (that is, panning determined by listener position):
 std::shared_ptr< PlayingSample > loop_3D(
 	Sample const &sample,
 	float volume,
 	glm::vec3 const &position,
-	float half_volume_radius = std::numeric_limits< float >::infinity()
+	float half_volume_radius = std::numeric_limits< float >::infinity(),
+	int priority = 0
+);
+
+//Call 'Sound::play' with a stream to play it until it runs out (looping, if any, is up to the stream):
+std::shared_ptr< PlayingSample > play(
+	std::shared_ptr< Stream > const &stream,
+	float volume = 1.0f,
+	float pan = 0.0f, //-1.0f == hard left, 1.0f == hard right
+	int priority = 0
+);
+std::shared_ptr< PlayingSample > play_3D(
+	std::shared_ptr< Stream > const &stream,
+	float volume,
+	glm::vec3 const &position,
+	float half_volume_radius = std::numeric_limits< float >::infinity(),
+	int priority = 0
 );
 
 //Listener controls the panning of "3D" samples (ones played using the "position" version of the play functions):
@@ -140,8 +195,11 @@ void stop_all_samples();
 void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
 extern Ramp< float > volume;
 
+//NOTE: the play/set_*/stop/... functions pass their changes to the audio callback through a
+// single-producer queue, so they should all be called from one thread (the game thread).
+
 //the audio callback doesn't run between Sound::lock() and Sound::unlock()
-// the set_*/stop/play/... functions already use these helpers, so you shouldn't need
+// the set_*/stop/play/... functions don't need these, so you shouldn't need
 // to call them unless your code is modifying values directly:
 void lock();
 void unlock();
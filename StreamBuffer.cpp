@@ -0,0 +1,117 @@
+#include "StreamBuffer.hpp"
+
+#include "Load.hpp"
+#include "gl_errors.hpp"
+
+#include <cassert>
+#include <cstring>
+
+StreamBuffer *stream_buffer = nullptr;
+
+static Load< void > setup_stream_buffer(LoadTagEarly, [](){
+	//1MB per segment is many frames of DrawLines output:
+	stream_buffer = new StreamBuffer(1 << 20, 4);
+});
+
+StreamBuffer::StreamBuffer(GLsizeiptr segment_size_, uint32_t segments) : segment_size(segment_size_), fences(segments, nullptr) {
+	assert(segments >= 2 && segment_size > 0);
+	glGenBuffers(1, &buffer);
+	resize(segment_size);
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (auto &fence : fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void StreamBuffer::resize(GLsizeiptr segment_size_) {
+	//n.b. re-specifying the storage orphans the old contents, so pending draws still see their data:
+	for (auto &fence : fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	segment_size = segment_size_;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, segment_size * GLsizeiptr(fences.size()), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	head = 0;
+	segment = 0;
+
+	GL_ERRORS();
+}
+
+void StreamBuffer::wait(uint32_t s) {
+	if (!fences[s]) return;
+	//fast path: already finished
+	GLenum result = glClientWaitSync(fences[s], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		waits += 1;
+		do {
+			result = glClientWaitSync(fences[s], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fences[s]);
+	fences[s] = nullptr;
+}
+
+GLintptr StreamBuffer::upload(void const *data, GLsizeiptr bytes, GLsizeiptr alignment) {
+	assert(alignment > 0);
+	if (bytes <= 0) return 0;
+
+	//every upload fits in one segment (even after alignment):
+	if (bytes + alignment > segment_size) {
+		GLsizeiptr size = segment_size;
+		while (size < bytes + alignment) size *= 2;
+		resize(size);
+	}
+
+	auto align = [alignment](GLintptr offset) {
+		return ((offset + alignment - 1) / alignment) * alignment;
+	};
+
+	GLsizeiptr capacity = segment_size * GLsizeiptr(fences.size());
+	GLintptr start = align(head);
+	//uploads never cross into the next segment, so a segment being left only holds data
+	// for draws that have already been issued (and its fence will cover them):
+	if (start / segment_size != (start + bytes - 1) / segment_size) {
+		start = align((start / segment_size + 1) * segment_size);
+	}
+	bool wrapped = false;
+	if (start + bytes > capacity) {
+		start = 0;
+		wrapped = true;
+	}
+
+	//move into the segment the copy goes in, fencing the ones being left:
+	uint32_t target = uint32_t(start / segment_size);
+	assert(target == uint32_t((start + bytes - 1) / segment_size));
+	while (segment != target || wrapped) {
+		assert(fences[segment] == nullptr);
+		fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		segment = (segment + 1) % uint32_t(fences.size());
+		wait(segment);
+		if (segment == 0) wrapped = false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	//unsynchronized is safe since the fences say the GPU is done with this range:
+	void *dst = glMapBufferRange(GL_ARRAY_BUFFER, start, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (dst) {
+		std::memcpy(dst, data, size_t(bytes));
+		if (glUnmapBuffer(GL_ARRAY_BUFFER) != GL_TRUE) {
+			//contents were lost (rare; e.g., mode switch), so copy them the slow way:
+			glBufferSubData(GL_ARRAY_BUFFER, start, bytes, data);
+		}
+	} else {
+		glBufferSubData(GL_ARRAY_BUFFER, start, bytes, data);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	head = start + bytes;
+
+	return start;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * StreamBuffer is a ring of vertex data for immediate-mode drawing.
+ *
+ * Data is copied into unused parts of one big buffer with
+ * glMapBufferRange(..., GL_MAP_UNSYNCHRONIZED_BIT). The storage is never
+ * reallocated, so uploads don't stall the way glBufferData can.
+ *
+ * The ring is split into segments. When writing moves on to the next
+ * segment, a fence is placed after the draws that used the old one.
+ * Before a segment is written again, its fence is waited on. With a few
+ * frames' worth of space this wait has already passed.
+ *
+ * Usage:
+ *   GLintptr offset = stream_buffer->upload(data, bytes, sizeof(Vertex));
+ *   //...then draw from stream_buffer->buffer starting at vertex offset / sizeof(Vertex)
+ *
+ */
+
+#include "GL.hpp"
+
+#include <vector>
+
+struct StreamBuffer {
+	//total size is 'segments * segment_size' bytes:
+	StreamBuffer(GLsizeiptr segment_size, uint32_t segments = 4);
+	~StreamBuffer();
+
+	StreamBuffer(StreamBuffer const &) = delete;
+	StreamBuffer &operator=(StreamBuffer const &) = delete;
+
+	//copy 'bytes' into the ring; returns the offset (a multiple of 'alignment') of the copy within 'buffer':
+	// n.b. leaves GL_ARRAY_BUFFER unbound
+	GLintptr upload(void const *data, GLsizeiptr bytes, GLsizeiptr alignment = 16);
+
+	//the buffer object (stays the same, even if the ring is resized):
+	GLuint buffer = 0;
+
+	//statistics:
+	uint64_t waits = 0; //times upload() had to wait for the GPU to finish with a segment
+
+	//internals:
+	GLsizeiptr segment_size;
+	std::vector< GLsync > fences; //per segment, set when writing leaves it
+	GLsizeiptr head = 0; //next free byte
+	uint32_t segment = 0; //segment containing head
+	void wait(uint32_t segment);
+	void resize(GLsizeiptr segment_size);
+};
+
+//ring shared by DrawLines and other immediate-mode drawers (created at LoadTagEarly):
+extern StreamBuffer *stream_buffer;
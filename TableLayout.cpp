@@ -0,0 +1,227 @@
+#include "TableLayout.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+//cards are filled with this (their outline color shows selection):
+static const glm::u8vec4 CardFace = glm::u8vec4(0x20, 0x20, 0x28, 0xff);
+static const glm::u8vec4 Blue = glm::u8vec4(0x00, 0x00, 0xff, 0xff);
+static const glm::u8vec4 Red = glm::u8vec4(0xff, 0x00, 0x00, 0xff);
+static const glm::u8vec4 White = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
+
+static glm::u8vec4 tuple_box_col(std::tuple<int, int, int, int> const &card) {
+	switch (std::get<2>(card)) {
+		case 0: // first select card
+			return glm::u8vec4(0xff, 0x00, 0xff, 0xff);
+		case 1: // second select card
+			return glm::u8vec4(0xff, 0x00, 0x00, 0xff);
+		default: // card not selected
+			return glm::u8vec4(0x00, 0x00, 0xff, 0xff);
+	}
+}
+
+static glm::u8vec4 tuple_text_col(std::tuple<int, int, int, int> const &card) {
+	if (std::get<0>(card) < 2) {
+		return glm::u8vec4(0xff, 0x00, 0x00, 0xff);
+	} else {
+		return glm::u8vec4(0xff, 0xff, 0xff, 0xff);
+	}
+}
+
+static uint16_t card_label(std::tuple<int, int, int, int> const &card) {
+	return DrawCards::card_label(std::get<0>(card), std::get<1>(card));
+}
+
+//numbers that a slot's text depends on are folded into its source as (-1, value, 0, 0):
+static std::tuple<int, int, int, int> number(int value) {
+	return std::make_tuple(-1, value, 0, 0);
+}
+
+glm::vec2 TableLayout::cell(bool own, int col, int row) {
+	float x = Game::ArenaMin.x + 0.1f + (CardWidth + 0.1f) * col;
+	if (own) return glm::vec2(x, Game::ArenaMin.y + 0.1f + CardHeight * row);
+	else return glm::vec2(x, Game::ArenaMax.y - 0.1f - CardHeight * row);
+}
+
+void TableLayout::update(Game const &game, View const &view_) {
+	if (built && version == game.state_version && view == view_) return;
+	version = game.state_version;
+	view = view_;
+	built = true;
+
+	bool done = false;
+	for (auto const &player : game.players) {
+		if (player.done) done = true;
+	}
+	int own_score = (game.players.empty() ? 0 : game.players.front().score);
+
+	//(a board going away changes what is drawn, even if no remaining board moves)
+	bool changed = (boards.size() != game.players.size());
+	boards.resize(game.players.size());
+
+	//place boards:
+	{
+		//the local player's board is drawn as-is; opponents are tiled over the top half of the arena:
+		uint32_t opponents = uint32_t(boards.size()) - (boards.empty() ? 0 : 1);
+		uint32_t cols = 1;
+		while (cols * cols < opponents) ++cols;
+		uint32_t rows = (opponents + cols - 1) / std::max(1U, cols);
+		glm::vec2 tile = (BoardMax - BoardMin) / glm::vec2(float(cols), float(std::max(1U, rows)));
+		float scale = std::min(tile.x / (BoardMax.x - BoardMin.x), tile.y / (BoardMax.y - BoardMin.y));
+
+		boards_culled = 0;
+		for (uint32_t b = 0; b < boards.size(); ++b) {
+			Board &board = boards[b];
+			glm::vec2 offset = glm::vec2(0.0f);
+			float s = 1.0f;
+			if (b > 0) {
+				uint32_t i = b - 1;
+				//(tiles fill rows from the top left)
+				glm::vec2 tile_min = glm::vec2(BoardMin.x + tile.x * (i % cols), BoardMax.y - tile.y * (i / cols + 1));
+				s = scale;
+				offset = tile_min - s * BoardMin;
+			}
+
+			//cull boards that are entirely off screen:
+			glm::vec2 min = (b == 0 ? Game::ArenaMin : offset + s * BoardMin);
+			glm::vec2 max = (b == 0 ? glm::vec2(Game::ArenaMax.x, BoardMin.y) : offset + s * BoardMax);
+			bool visible = !(max.x < view.min.x || min.x > view.max.x || max.y < view.min.y || min.y > view.max.y);
+			if (!visible) boards_culled += 1;
+
+			//pick detail from the on-screen size of a card (always show the local player's cards):
+			Detail detail = Full;
+			if (b > 0 && CardHeight * s * view.pixels_per_unit < MinCardPixels) detail = Counts;
+
+			if (visible != board.visible || offset != board.offset || s != board.scale || detail != board.detail) changed = true;
+			board.visible = visible;
+			board.offset = offset;
+			board.scale = s;
+			board.detail = detail;
+		}
+	}
+
+	std::vector< std::tuple< int, int, int, int > > source;
+	auto board = boards.begin();
+	for (auto const &player : game.players) {
+		bool own = (&player == &game.players.front());
+		if (!board->visible) {
+			++board;
+			continue;
+		}
+		Detail detail = board->detail;
+
+		for (uint32_t slot = 0; slot < Slots; ++slot) {
+			SlotLayout &layout = board->slots[slot];
+
+			//what the slot shows:
+			source.clear();
+			if (detail == Counts) {
+				//the score slot summarizes the whole board:
+				if (slot == ScoreSlot) {
+					source.emplace_back(number(int(player.neg_pile.size())));
+					source.emplace_back(number(player.score));
+				}
+			} else if (slot == NegSlot) {
+				if (!player.neg_pile.empty()) source.emplace_back(player.neg_pile.back());
+				source.emplace_back(number(int(player.neg_pile.size())));
+			} else if (slot == PosSlot) {
+				if (own && !player.pos_pile.empty()) source.emplace_back(player.pos_pile.at(player.pos_pos));
+				source.emplace_back(number(int(player.pos_pile.size())));
+			} else if (slot >= ActiveSlot && slot < ActiveSlot + 4) {
+				auto const &pile = *player.active_pile(2 + int(slot - ActiveSlot));
+				source.assign(pile.begin(), pile.end());
+			} else if (slot >= SuitSlot && slot < SuitSlot + 4) {
+				auto const &top = *player.suit_pile(6 + int(slot - SuitSlot));
+				source.emplace_back(top);
+			} else { assert(slot == ScoreSlot);
+				source.emplace_back(number(done && !own));
+				source.emplace_back(number(own_score));
+				source.emplace_back(number(player.score));
+			}
+			//(ownership and detail matter too, since they change how the slot is drawn)
+			source.emplace_back(number(own));
+			source.emplace_back(number(detail));
+
+			if (layout.built && layout.source == source) continue;
+
+			//rebuild:
+			layout.built = true;
+			layout.source = source;
+			layout.cards.clear();
+			layout.texts.clear();
+			changed = true;
+			slots_rebuilt += 1;
+
+			auto card = [&](int col, int row, glm::u8vec4 const &border, uint16_t label, glm::u8vec4 const &label_color) {
+				glm::vec2 a = cell(own, col, row);
+				glm::vec2 b = cell(own, col, row + 1) + glm::vec2(CardWidth, 0.0f);
+				layout.cards.emplace_back(glm::min(a, b), glm::max(a, b), CardFace, border, label_color, label);
+			};
+			auto text = [&](int col, int row, std::string const &str) {
+				layout.texts.emplace_back(Text{cell(own, col, row) + LabelOffset, str, White});
+			};
+
+			if (detail == Counts) {
+				if (slot == ScoreSlot) {
+					//big enough to read at the scales Counts is used at:
+					constexpr float H = 4.0f * LabelHeight;
+					layout.texts.emplace_back(Text{cell(own, 0, 6) + LabelOffset, player.name, White, H});
+					layout.texts.emplace_back(Text{cell(own, 0, 11) + LabelOffset, std::to_string(player.neg_pile.size()) + " left, " + std::to_string(player.score) + " pts", White, H});
+				}
+			} else if (slot == NegSlot) {
+				if (!player.neg_pile.empty()) {
+					auto const &top = player.neg_pile.back();
+					card(0, 12, own ? tuple_box_col(top) : Blue, card_label(top), tuple_text_col(top));
+				} else {
+					card(0, 12, Red, DrawCards::LabelEnd, Red);
+				}
+				text(0, own ? 11 : 12, std::to_string(player.neg_pile.size()));
+			} else if (slot == PosSlot) {
+				//(don't care about other players' pos_pile)
+				if (own) {
+					if (!player.pos_pile.empty()) {
+						auto const &top = player.pos_pile.at(player.pos_pos);
+						card(0, 0, tuple_box_col(top), card_label(top), tuple_text_col(top));
+					} else {
+						card(0, 0, Red, DrawCards::LabelNone, Red);
+					}
+				}
+			} else if (slot >= ActiveSlot && slot < ActiveSlot + 4) {
+				int col = 1 + int(slot - ActiveSlot);
+				for (uint32_t i = 0; i + 2 < source.size(); ++i) {
+					auto const &c = source[i];
+					card(col, 12 - int(i), own ? tuple_box_col(c) : Blue, card_label(c), tuple_text_col(c));
+				}
+			} else if (slot >= SuitSlot && slot < SuitSlot + 4) {
+				int col = 1 + int(slot - SuitSlot);
+				auto const &top = source[0];
+				card(col, 15, own ? tuple_box_col(top) : Blue, card_label(top), tuple_text_col(top));
+			} else { assert(slot == ScoreSlot);
+				if (done && !own) {
+					text(0, 1, std::to_string(own_score) + " vs. " + std::to_string(player.score));
+				}
+			}
+		}
+		++board;
+	}
+
+	if (!changed && cards.size() + texts.size() > 0) return;
+
+	//flatten visible boards into world space:
+	cards.clear();
+	texts.clear();
+	for (auto const &b : boards) {
+		if (!b.visible) continue;
+		for (auto const &slot : b.slots) {
+			for (auto const &c : slot.cards) {
+				cards.emplace_back(c);
+				cards.back().Rect = glm::vec4(b.offset, b.offset) + b.scale * c.Rect;
+			}
+			for (auto const &t : slot.texts) {
+				texts.emplace_back(t);
+				texts.back().at = b.offset + b.scale * t.at;
+				texts.back().height = b.scale * t.height;
+			}
+		}
+	}
+}
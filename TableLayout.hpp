@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+ * TableLayout keeps the table's cards and labels laid out, so PlayMode::draw
+ * only has to walk prebuilt lists.
+ *
+ * Each player's board is split into slots (neg pile, pos pile, active piles, suit
+ * piles, score). A slot remembers the cards it was built from; update() does
+ * nothing unless Game::state_version (or the view) changed, and then only rebuilds
+ * the slots whose cards changed.
+ *
+ * Slots are laid out in board space (the layout a lone opponent gets), and boards
+ * are placed with a scale + offset when flattened. With more than one opponent,
+ * opponents' boards are tiled into a grid over the top half of the arena:
+ *  - boards outside the view are culled (skipped entirely, not even diffed);
+ *  - boards whose cards would be too small to read are drawn at 'Counts' detail
+ *    (name, cards left, and score) instead of card-by-card.
+ * So the amount drawn stays about the same as the table grows.
+ *
+ */
+
+#include "Game.hpp"
+#include "DrawCards.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct TableLayout {
+	//what part of the world is on screen:
+	struct View {
+		glm::vec2 min = Game::ArenaMin;
+		glm::vec2 max = Game::ArenaMax;
+		float pixels_per_unit = 500.0f;
+		bool operator==(View const &o) const { return min == o.min && max == o.max && pixels_per_unit == o.pixels_per_unit; }
+	};
+
+	//bring layout up to date with 'game' as seen through 'view':
+	void update(Game const &game, View const &view);
+
+	//prebuilt output, in world space:
+	std::vector< DrawCards::Instance > cards;
+	struct Text {
+		glm::vec2 at;
+		std::string text;
+		glm::u8vec4 color;
+		float height = LabelHeight;
+	};
+	std::vector< Text > texts;
+
+	//where card labels go, in board space:
+	inline static constexpr glm::vec2 LabelOffset = glm::vec2(0.075f, 0.0f);
+	inline static constexpr float LabelHeight = 0.04f;
+
+	//board geometry:
+	inline static constexpr float CardWidth = (Game::ArenaMax.x - Game::ArenaMin.x - 0.1f * 6.0f) / 5.0f;
+	inline static constexpr float CardHeight = 0.05f;
+	//corner of the card at column 'col', row 'row' of a board (the card spans to cell(own, col, row + 1) + (CardWidth, 0)):
+	// (the local player's board is laid out up from the bottom of the arena, others' down from the top)
+	static glm::vec2 cell(bool own, int col, int row);
+	//opponents' boards (in board space) fit in:
+	inline static constexpr glm::vec2 BoardMin = glm::vec2(Game::ArenaMin.x, 0.0f);
+	inline static constexpr glm::vec2 BoardMax = Game::ArenaMax;
+
+	//boards with cards shorter than this many pixels are drawn at Counts detail:
+	inline static constexpr float MinCardPixels = 9.0f;
+
+	//statistics:
+	uint64_t slots_rebuilt = 0;
+	uint32_t boards_culled = 0; //(as of last update)
+
+	//internals:
+	enum Slot : uint32_t {
+		NegSlot,
+		PosSlot,
+		ActiveSlot, //four of these
+		SuitSlot = ActiveSlot + 4, //four of these
+		ScoreSlot = SuitSlot + 4,
+		Slots
+	};
+	enum Detail : int {
+		Full,
+		Counts,
+	};
+	struct SlotLayout {
+		bool built = false;
+		std::vector< std::tuple< int, int, int, int > > source; //what the slot was built from
+		std::vector< DrawCards::Instance > cards; //in board space
+		std::vector< Text > texts; //in board space
+	};
+	struct Board {
+		std::array< SlotLayout, Slots > slots;
+		//board space -> world space:
+		glm::vec2 offset = glm::vec2(0.0f);
+		float scale = 1.0f;
+		Detail detail = Full;
+		bool visible = true;
+	};
+	std::vector< Board > boards; //in game.players order (front is the local player)
+	uint32_t version = 0;
+	View view;
+	bool built = false;
+};
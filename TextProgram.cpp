@@ -0,0 +1,73 @@
+#include "TextProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "gl_errors.hpp"
+
+Load< TextProgram > text_program(LoadTagEarly);
+
+TextProgram::TextProgram() {
+	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform mat4 OBJECT_TO_CLIP;\n"
+		"in vec2 Origin;\n" //per-instance: glyph origin (on the baseline)
+		"in vec2 X;\n" //per-instance: one glyph unit along the baseline
+		"in vec2 Y;\n" //per-instance: one glyph unit up (one glyph unit is the text height)
+		"in vec4 Color;\n"
+		"in float Glyph;\n" //atlas cell
+		"out vec2 uv;\n"
+		"flat out vec4 color;\n"
+		"void main() {\n"
+		//the quad covers the glyph's whole atlas cell, which is [-0.375,1.0]x[-0.75,1.375] in glyph units, in a 16x6 grid of cells:
+		"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+		"	vec2 at = mix(vec2(-0.375, -0.75), vec2(1.0, 1.375), corner);\n"
+		"	gl_Position = OBJECT_TO_CLIP * vec4(Origin + X * at.x + Y * at.y, 0.0, 1.0);\n"
+		"	uv = (vec2(mod(Glyph, 16.0), floor(Glyph / 16.0)) + corner) / vec2(16.0, 6.0);\n"
+		"	color = Color;\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"uniform sampler2D DISTANCES;\n"
+		"uniform float WEIGHT;\n"
+		"in vec2 uv;\n"
+		"flat in vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		//atlas stores distance to the nearest stroke centerline, with 1.0 at the stroke and 0.0 a quarter glyph unit or more away:
+		"	float dist = (1.0 - texture(DISTANCES, uv).r) * 0.25;\n"
+		"	float px = fwidth(dist);\n"
+		//strokes are WEIGHT glyph units either side of the centerline, but never thinner than a pixel or so:
+		"	float radius = max(WEIGHT, 0.75 * px);\n"
+		"	float ink = clamp((radius - dist) / max(px, 1e-6) + 0.5, 0.0, 1.0);\n"
+		"	fragColor = vec4(color.rgb, color.a * ink);\n"
+		"}\n"
+	);
+	//As you can see above, adjacent strings in C/C++ are concatenated.
+	// this is very useful for writing long shader programs inline.
+
+	//look up the locations of vertex attributes:
+	Origin_vec2 = glGetAttribLocation(program, "Origin");
+	X_vec2 = glGetAttribLocation(program, "X");
+	Y_vec2 = glGetAttribLocation(program, "Y");
+	Color_vec4 = glGetAttribLocation(program, "Color");
+	Glyph_float = glGetAttribLocation(program, "Glyph");
+
+	//look up the locations of uniforms:
+	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
+	WEIGHT_float = glGetUniformLocation(program, "WEIGHT");
+	GLuint DISTANCES_sampler2D = glGetUniformLocation(program, "DISTANCES");
+
+	//set DISTANCES to always refer to texture binding zero:
+	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+
+	glUniform1i(DISTANCES_sampler2D, 0); //set DISTANCES to sample from GL_TEXTURE0
+
+	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+}
+
+TextProgram::~TextProgram() {
+	glDeleteProgram(program);
+	program = 0;
+}
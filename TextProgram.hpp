@@ -0,0 +1,26 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+//Shader program that draws instanced glyph quads from a signed-distance-field atlas:
+// (see DrawText for the per-instance data and the atlas layout)
+struct TextProgram {
+	TextProgram();
+	~TextProgram();
+
+	GLuint program = 0;
+	//Attribute (per-instance variable) locations:
+	GLuint Origin_vec2 = -1U;
+	GLuint X_vec2 = -1U;
+	GLuint Y_vec2 = -1U;
+	GLuint Color_vec4 = -1U;
+	GLuint Glyph_float = -1U;
+	//Uniform (per-invocation variable) locations:
+	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+	GLuint WEIGHT_float = -1U;
+	//Textures:
+	//TEXTURE0 - glyph distance atlas (see DrawText.cpp)
+};
+
+extern Load< TextProgram > text_program;
@@ -0,0 +1,79 @@
+#include "TickScheduler.hpp"
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+TickScheduler::TickScheduler(double tick_, uint32_t max_catch_up_)
+	: tick(std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(tick_))),
+	  max_catch_up(max_catch_up_) {
+	if (tick <= Clock::duration::zero()) tick = Clock::duration(1);
+	next = Clock::now() + tick;
+
+#ifdef __linux__
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd < 0) {
+		std::cerr << "WARNING: timerfd_create failed; falling back to select() timeouts for tick timing." << std::endl;
+	}
+#endif
+	arm_timer();
+}
+
+TickScheduler::~TickScheduler() {
+#ifdef __linux__
+	if (timer_fd >= 0) {
+		close(timer_fd);
+		timer_fd = -1;
+	}
+#endif
+}
+
+double TickScheduler::remaining() const {
+	return std::chrono::duration< double >(next - Clock::now()).count();
+}
+
+uint32_t TickScheduler::advance() {
+	auto now = Clock::now();
+	if (now < next) return 0;
+
+	max_late = std::max(max_late, std::chrono::duration< double >(now - next).count());
+
+	//every deadline up to 'now' has passed; run the first few and skip the rest:
+	uint64_t due = 1 + uint64_t((now - next) / tick);
+	uint64_t run = std::min< uint64_t >(due, uint64_t(max_catch_up) + 1);
+	skipped += due - run;
+	ticks += run;
+
+	//n.b. stays on the original grid of deadlines, even when skipping:
+	next += tick * due;
+	arm_timer();
+
+	return uint32_t(run);
+}
+
+void TickScheduler::arm_timer() {
+#ifdef __linux__
+	if (timer_fd < 0) return;
+
+	//clear any expiration that has already happened:
+	uint64_t expirations;
+	if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+		//(EAGAIN -- timer hadn't fired -- is expected)
+	}
+
+	//n.b. steady_clock is CLOCK_MONOTONIC on linux, so deadlines can be used as absolute timer values:
+	auto ns = std::chrono::duration_cast< std::chrono::nanoseconds >(next.time_since_epoch()).count();
+	struct itimerspec spec = {};
+	spec.it_value.tv_sec = time_t(ns / 1000000000);
+	spec.it_value.tv_nsec = long(ns % 1000000000);
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+		std::cerr << "WARNING: timerfd_settime failed; falling back to select() timeouts for tick timing." << std::endl;
+		close(timer_fd);
+		timer_fd = -1;
+	}
+#endif
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Fixed-timestep scheduling for the server's main loop.
+ *
+ * Tick deadlines are always start + n * tick, so timing errors don't add up.
+ * When a tick overruns, advance() asks for the missed ticks to be run
+ * back-to-back. It asks for at most max_catch_up extra ticks; any beyond
+ * that are skipped and counted in 'skipped'.
+ *
+ * On linux, wake_fd() is a timerfd armed for the next deadline. Passing it to
+ * Server::poll wakes the loop when the tick is due, instead of relying on
+ * select()'s timeout.
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+
+struct TickScheduler {
+	using Clock = std::chrono::steady_clock;
+
+	//'tick' is in seconds; first tick is due one tick from now:
+	TickScheduler(double tick, uint32_t max_catch_up = 3);
+	~TickScheduler();
+
+	TickScheduler(TickScheduler const &) = delete;
+	TickScheduler &operator=(TickScheduler const &) = delete;
+
+	//seconds until the next tick is due (zero or negative if it is due now):
+	double remaining() const;
+
+	//returns the number of ticks to run now (zero if the next tick isn't due yet):
+	// (usually one; more when catching up after an overrun)
+	uint32_t advance();
+
+	//file descriptor that becomes readable when the next tick is due (-1 if not supported on this platform):
+	int wake_fd() const { return timer_fd; }
+
+	//statistics:
+	uint64_t ticks = 0; //ticks handed out by advance()
+	uint64_t skipped = 0; //ticks dropped because the loop fell more than max_catch_up ticks behind
+	double max_late = 0.0; //latest (in seconds) advance() has been called after a deadline
+
+	//internals:
+	Clock::duration tick;
+	uint32_t max_catch_up;
+	Clock::time_point next; //deadline of the next tick
+	int timer_fd = -1;
+	void arm_timer();
+};
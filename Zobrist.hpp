@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * Zobrist keys for pile state.
+ *
+ * A position's hash is the XOR of the keys of its features, so adding or
+ *  removing a single card updates the hash with a single XOR.
+ * Player (Game.cpp) and Solver::State (Solver.cpp) use the same features,
+ *  so a State copied from a Player has the same hash as the Player.
+ *
+ * Rather than storing tables of random numbers, keys are made by running
+ *  a feature number through the splitmix64 finalizer.
+ *
+ */
+
+#include <cstdint>
+
+namespace Zobrist {
+
+inline uint64_t key(uint64_t feature) {
+	uint64_t z = feature + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//card (suit * 13 + rank) at 'index' (from the bottom) of a pile:
+// piles are numbered as in Player::first / second -- 0: pos_pile, 1: neg_pile, 2-5: active piles
+inline uint64_t card(uint32_t pile, uint32_t index, uint32_t card) {
+	return key((uint64_t(1) << 32) | (pile << 16) | (index << 8) | card);
+}
+
+//rank of the top card of a suit pile (-1 when empty):
+inline uint64_t suit(uint32_t suit, int32_t rank) {
+	return key((uint64_t(2) << 32) | (suit << 8) | uint32_t(rank + 1));
+}
+
+//which pos_pile card is available:
+inline uint64_t pos_pos(int32_t pos) {
+	return key((uint64_t(3) << 32) | uint32_t(pos));
+}
+
+} //namespace Zobrist
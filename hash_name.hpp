@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+ * Names (e.g., of meshes in a MeshBuffer) can be interned as 32-bit hashes,
+ *  so looking them up doesn't need to build or compare strings.
+ *
+ * hash_name is constexpr, so names that appear in code can be hashed at compile time:
+ *   static constexpr NameHash Spindle = hash_name("Spindle");
+ *   Mesh const &mesh = meshes->lookup(Spindle);
+ *
+ * Different names can (rarely) have the same hash, so whatever indexes things
+ *  by hash should check for collisions when it is loaded.
+ */
+
+#include <cstdint>
+#include <string_view>
+
+typedef uint32_t NameHash;
+
+//32-bit FNV-1a, except that zero (which marks empty slots in hash tables) becomes one:
+constexpr NameHash hash_name(std::string_view name) {
+	uint32_t hash = 2166136261u;
+	for (char c : name) {
+		hash = (hash ^ uint8_t(c)) * 16777619u;
+	}
+	return (hash == 0 ? 1 : hash);
+}
+
+static_assert(hash_name("") == 2166136261u && hash_name("a") == 0xe40c292cu, "hash_name is FNV-1a.");
@@ -0,0 +1,271 @@
+#include "Game.hpp"
+#include "Solver.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Plays lots of deals (as dealt by Game::spawn_player) with a bot and reports how often the bot wins.
+// useful for checking how a rules change (neg pile size, flip count, ...) affects balance without running matches.
+
+enum class Policy {
+	Random, //any legal move
+	Greedy, //suit piles, then neg pile, then pos pile, then flip, then between active piles
+	Search, //Solver::best_move
+};
+
+struct Options {
+	uint64_t deals = 100000;
+	uint32_t threads = 0; //0 means "one per core"
+	uint32_t seed = 0;
+	Policy policy = Policy::Greedy;
+	uint32_t depth = 4; //for Policy::Search
+	uint32_t max_moves = 1000; //per deal
+	uint32_t stall_moves = 100; //give up after this many moves without cards leaving the pos or neg piles
+};
+
+//what happened in one deal:
+struct Outcome {
+	uint32_t score = 0;
+	uint32_t neg_left = 0;
+	uint32_t moves = 0;
+};
+
+//pick one of moves[0..count) into *move; returns false if the policy would rather end the deal:
+static bool choose_move(Options const &options, Solver::State const &state, Solver::Move const *moves, uint32_t count, std::mt19937 &mt, Solver *solver, Solver::Move *move) {
+	assert(count > 0);
+	assert(move);
+	auto pick = [&](auto &&want) {
+		for (uint32_t m = 0; m < count; ++m) {
+			if (want(moves[m])) {
+				*move = moves[m];
+				return true;
+			}
+		}
+		return false;
+	};
+	if (options.policy == Policy::Random) {
+		*move = moves[std::uniform_int_distribution< uint32_t >(0, count - 1)(mt)];
+		return true;
+	} else if (options.policy == Policy::Greedy) {
+		//moves are listed suit piles first, so the first one that scores is as good as any:
+		if (moves[0].to != Solver::Move::Flip && moves[0].to >= 6) {
+			*move = moves[0];
+			return true;
+		}
+		if (pick([](Solver::Move const &m){ return m.from == 1; })) return true;
+		if (pick([](Solver::Move const &m){ return m.from == 0; })) return true;
+		//(a flip is only listed when it changes which pos card is available)
+		if (pick([](Solver::Move const &m){ return m.from == Solver::Move::Flip; })) return true;
+		if (pick([](Solver::Move const &m){ return m.from >= 2 && m.from < 6; })) return true;
+		return false;
+	} else { assert(options.policy == Policy::Search);
+		assert(solver);
+		return solver->best_move(state, options.depth, move);
+	}
+}
+
+static Outcome play(Options const &options, Solver::State state, std::mt19937 &mt, Solver *solver) {
+	Outcome outcome;
+
+	uint32_t since_progress = 0;
+	Solver::Move moves[Solver::MaxMoves];
+	while (outcome.moves < options.max_moves && since_progress < options.stall_moves) {
+		uint32_t count = Solver::generate_moves(state, moves);
+		if (count == 0) break;
+
+		Solver::Move move;
+		if (!choose_move(options, state, moves, count, mt, solver, &move)) break;
+		uint32_t before = state.pos_count + state.neg_count;
+		Solver::apply(state, move);
+		outcome.moves += 1;
+
+		if (uint32_t(state.pos_count + state.neg_count) < before) since_progress = 0;
+		else since_progress += 1;
+	}
+
+	outcome.score = state.score;
+	outcome.neg_left = state.neg_count;
+	return outcome;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+
+	//------------ argument parsing ------------
+
+	Options options;
+	bool usage = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--deals" && i + 1 < argc) {
+			options.deals = std::stoull(argv[i+1]);
+			i += 1;
+		} else if (arg == "--threads" && i + 1 < argc) {
+			options.threads = uint32_t(std::stoul(argv[i+1]));
+			i += 1;
+		} else if (arg == "--seed" && i + 1 < argc) {
+			options.seed = uint32_t(std::stoul(argv[i+1]));
+			i += 1;
+		} else if (arg == "--policy" && i + 1 < argc) {
+			std::string policy = argv[i+1];
+			if (policy == "random") options.policy = Policy::Random;
+			else if (policy == "greedy") options.policy = Policy::Greedy;
+			else if (policy == "search") options.policy = Policy::Search;
+			else usage = true;
+			i += 1;
+		} else if (arg == "--depth" && i + 1 < argc) {
+			options.depth = uint32_t(std::stoul(argv[i+1]));
+			i += 1;
+		} else if (arg == "--max-moves" && i + 1 < argc) {
+			options.max_moves = uint32_t(std::stoul(argv[i+1]));
+			i += 1;
+		} else {
+			usage = true;
+		}
+	}
+
+	if (usage) {
+		std::cerr << "Usage:\n\t./montecarlo [--deals <n>] [--threads <n>] [--seed <n>] [--policy random|greedy|search] [--depth <n>] [--max-moves <n>]" << std::endl;
+		return 1;
+	}
+
+	if (options.threads == 0) {
+		options.threads = std::max(1U, std::thread::hardware_concurrency());
+	}
+
+	//------------ simulation ------------
+
+	//results are tallied per-thread and added in with atomics, so threads never wait on each other:
+	std::array< std::atomic< uint64_t >, 53 > score_counts;
+	std::array< std::atomic< uint64_t >, 14 > neg_left_counts;
+	std::atomic< uint64_t > total_moves(0);
+	for (auto &c : score_counts) c.store(0);
+	for (auto &c : neg_left_counts) c.store(0);
+
+	//deals are handed out in chunks; deal 'i' is always seeded the same way,
+	// so results don't depend on the number of threads:
+	constexpr uint64_t Chunk = 256;
+	std::atomic< uint64_t > next_deal(0);
+
+	auto worker = [&]() {
+		Game game; //(only used to deal)
+		std::unique_ptr< Solver > solver;
+		if (options.policy == Policy::Search) solver.reset(new Solver(16));
+
+		std::array< uint64_t, 53 > scores;
+		std::array< uint64_t, 14 > neg_lefts;
+		uint64_t moves;
+
+		while (true) {
+			uint64_t begin = next_deal.fetch_add(Chunk, std::memory_order_relaxed);
+			if (begin >= options.deals) break;
+			uint64_t end = std::min(begin + Chunk, options.deals);
+
+			scores.fill(0);
+			neg_lefts.fill(0);
+			moves = 0;
+
+			for (uint64_t deal = begin; deal < end; ++deal) {
+				std::seed_seq seq{options.seed, uint32_t(deal), uint32_t(deal >> 32)};
+				game.mt.seed(seq);
+				Player *player = game.spawn_player();
+				Solver::State state(*player);
+				game.remove_player(player);
+
+				//(the bot's choices continue from the same generator)
+				Outcome outcome = play(options, state, game.mt, solver.get());
+				scores[std::min(outcome.score, 52U)] += 1;
+				neg_lefts[std::min(outcome.neg_left, 13U)] += 1;
+				moves += outcome.moves;
+			}
+
+			for (uint32_t i = 0; i < scores.size(); ++i) {
+				if (scores[i]) score_counts[i].fetch_add(scores[i], std::memory_order_relaxed);
+			}
+			for (uint32_t i = 0; i < neg_lefts.size(); ++i) {
+				if (neg_lefts[i]) neg_left_counts[i].fetch_add(neg_lefts[i], std::memory_order_relaxed);
+			}
+			total_moves.fetch_add(moves, std::memory_order_relaxed);
+		}
+	};
+
+	auto before = std::chrono::steady_clock::now();
+
+	std::vector< std::thread > threads;
+	threads.reserve(options.threads);
+	for (uint32_t t = 0; t < options.threads; ++t) {
+		threads.emplace_back(worker);
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	double elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+
+	//------------ report ------------
+
+	uint64_t deals = options.deals;
+	if (deals == 0) {
+		std::cout << "No deals played." << std::endl;
+		return 0;
+	}
+
+	//a win is emptying the neg pile:
+	uint64_t wins = neg_left_counts[0].load();
+	double win_rate = double(wins) / double(deals);
+	//(normal approximation of the 95% confidence interval)
+	double margin = 1.96 * std::sqrt(win_rate * (1.0 - win_rate) / double(deals));
+
+	double score_sum = 0.0;
+	for (uint32_t i = 0; i < score_counts.size(); ++i) {
+		score_sum += double(i) * double(score_counts[i].load());
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Played " << deals << " deals on " << options.threads << " thread(s) in " << elapsed << " seconds";
+	if (elapsed > 0.0) {
+		std::cout << " (" << std::setprecision(0) << (deals / elapsed) << " deals/second)" << std::setprecision(2);
+	}
+	std::cout << "." << std::endl;
+	std::cout << "Win rate: " << (100.0 * win_rate) << "% +/- " << (100.0 * margin) << "%" << std::endl;
+	std::cout << "Mean score: " << (score_sum / double(deals)) << ", mean moves: " << (double(total_moves.load()) / double(deals)) << std::endl;
+
+	auto histogram = [&](char const *title, auto const &counts) {
+		std::cout << title << std::endl;
+		for (uint32_t i = 0; i < counts.size(); ++i) {
+			uint64_t count = counts[i].load();
+			if (count == 0) continue;
+			double fraction = double(count) / double(deals);
+			std::cout << "  " << std::setw(2) << i << ": " << std::setw(6) << (100.0 * fraction) << "% " << std::string(size_t(std::round(fraction * 50.0)), '#') << std::endl;
+		}
+	};
+	histogram("Score:", score_counts);
+	histogram("Neg pile cards left:", neg_left_counts);
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
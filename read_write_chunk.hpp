@@ -2,8 +2,13 @@
 
 #include <iostream>
 #include <vector>
+#include <list>
 #include <stdexcept>
 #include <cassert>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 //helper function that reads an array of structures preceded by a simple header:
 //Expected format:
@@ -41,6 +46,78 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 }
 
 
+//read-only view of an array of T (e.g., a chunk returned by ChunkReader):
+template< typename T >
+struct ChunkSpan {
+	T const *data = nullptr;
+	size_t count = 0;
+
+	T const *begin() const { return data; }
+	T const *end() const { return data + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T const &operator[](size_t i) const { assert(i < count); return data[i]; }
+};
+
+//helper that reads chunks (in the same format as read_chunk) in place from memory -- usually a MappedFile:
+// returned spans point straight into that memory, so no copies are made; they stay valid as long as
+// the memory (and, for copied chunks, the reader) does.
+struct ChunkReader {
+	ChunkReader(void const *data, size_t size) : at(reinterpret_cast< char const * >(data)), end(at + size) { }
+
+	template< typename T >
+	ChunkSpan< T > read_chunk(std::string const &magic) {
+		static_assert(std::is_trivially_copyable< T >::value, "chunks are read as raw bytes");
+
+		struct ChunkHeader {
+			char magic[4];
+			uint32_t size;
+		};
+		static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+		if (size_t(end - at) < sizeof(ChunkHeader)) {
+			throw std::runtime_error("Failed to read chunk header");
+		}
+		ChunkHeader header;
+		std::memcpy(&header, at, sizeof(header)); //(header itself may not be aligned)
+		if (std::string(header.magic,4) != magic) {
+			throw std::runtime_error("Unexpected magic number in chunk");
+		}
+		if (header.size % sizeof(T) != 0) {
+			throw std::runtime_error("Size of chunk not divisible by element size");
+		}
+		if (size_t(end - at) - sizeof(ChunkHeader) < header.size) {
+			throw std::runtime_error("Failed to read chunk data.");
+		}
+
+		char const *bytes = at + sizeof(ChunkHeader);
+		at = bytes + header.size;
+
+		ChunkSpan< T > span;
+		span.count = header.size / sizeof(T);
+		if (reinterpret_cast< uintptr_t >(bytes) % alignof(T) == 0) {
+			span.data = reinterpret_cast< T const * >(bytes);
+		} else {
+			//chunk isn't aligned well enough to use as T's in place (e.g., it follows a string chunk), so copy it:
+			copies.emplace_back((header.size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+			std::memcpy(copies.back().data(), bytes, header.size);
+			span.data = reinterpret_cast< T const * >(copies.back().data());
+		}
+		return span;
+	}
+
+	//has everything been read?
+	bool at_end() const { return at == end; }
+
+	//magic number of the next chunk (empty if there isn't a whole chunk header left):
+	std::string peek_magic() const { return (size_t(end - at) < 8 ? std::string() : std::string(at, 4)); }
+
+	char const *at;
+	char const *end;
+	std::list< std::vector< std::max_align_t > > copies; //misaligned chunks
+};
+
+
 //helper function to write a chunk of data in the same format as read_chunk:
 template< typename T >
 void write_chunk(std::string const &magic, std::vector< T > const &from, std::ostream *to_) {
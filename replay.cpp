@@ -0,0 +1,92 @@
+#include "Replay.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Re-simulates recorded matches as fast as possible and reports the outcome of each.
+// useful for checking how a rules change would have affected archived matches.
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+
+	//------------ argument parsing ------------
+
+	uint32_t checkpoint_interval = 300;
+	int64_t seek = -1;
+	bool quiet = false;
+	std::vector< std::string > files;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--checkpoint-interval" && i + 1 < argc) {
+			checkpoint_interval = uint32_t(std::stoul(argv[i+1]));
+			i += 1;
+		} else if (arg == "--seek" && i + 1 < argc) {
+			seek = std::stoll(argv[i+1]);
+			i += 1;
+		} else if (arg == "--quiet") {
+			quiet = true;
+		} else if (arg.size() > 0 && arg[0] == '-') {
+			files.clear();
+			break;
+		} else {
+			files.emplace_back(arg);
+		}
+	}
+
+	if (files.empty()) {
+		std::cerr << "Usage:\n\t./replay [--checkpoint-interval <ticks>] [--seek <tick>] [--quiet] <file.replay> [...]" << std::endl;
+		return 1;
+	}
+
+	//------------ simulation ------------
+
+	uint64_t total_ticks = 0;
+	auto before = std::chrono::steady_clock::now();
+
+	for (auto const &filename : files) {
+		ReplayLog log(filename);
+		ReplaySimulator sim(log, checkpoint_interval);
+
+		sim.run_to(sim.end_tick());
+		total_ticks += sim.tick;
+
+		//seeking (backward, usually) exercises the checkpoints:
+		if (seek >= 0) {
+			sim.seek(uint32_t(seek));
+		}
+
+		if (!quiet) {
+			//(the hash makes it easy to spot replays that diverge after a rules change)
+			std::cout << filename << " @ tick " << sim.tick << " (hash " << std::hex << sim.game.hash << std::dec << "):";
+			for (auto const &player : sim.game.players) {
+				std::cout << " [" << player.name << " score " << player.score << ", " << player.neg_pile.size() << " left" << (player.done ? ", done" : "") << "]";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	double elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	std::cout << "Simulated " << files.size() << " replay(s), " << total_ticks << " ticks in " << elapsed << " seconds";
+	if (elapsed > 0.0) {
+		std::cout << " (" << (total_ticks / elapsed) << " ticks/second)";
+	}
+	std::cout << "." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -15,7 +15,7 @@ for i in range(0,len(sys.argv)):
 		args = sys.argv[i+1:]
 
 if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-meshes.py -- <infile.blend[:collection]> <outfile.pnct>\nExports the meshes referenced by all objects in the specified collection(s) (default: all objects) to a binary blob.\n")
+	print("\n\nUsage:\nblender --background --python export-meshes.py -- <infile.blend[:collection]> <outfile.pnct|outfile.ipnct>\nExports the meshes referenced by all objects in the specified collection(s) (default: all objects) to a binary blob.\n'.pnct' files hold plain triangle lists; '.ipnct' files hold indexed, quantized meshes (see Mesh.hpp).\n")
 	exit(1)
 
 import bpy
@@ -28,7 +28,8 @@ if m:
 	collection_name = m.group(2)
 outfile = args[1]
 
-assert outfile.endswith(".pnct")
+assert outfile.endswith(".pnct") or outfile.endswith(".ipnct")
+indexed = outfile.endswith(".ipnct")
 
 print("Will export meshes referenced from ",end="")
 if collection_name:
@@ -39,6 +40,136 @@ print(" of '" + infile + "' to '" + outfile + "'.")
 
 import struct
 
+#---- indexed, quantized ('.ipnct') output ----
+#meshes are still built as '.pnct'-format triangle lists, then converted by pack_indexed()
+
+PNCT_SIZE = 4*3+4*3+1*4+4*2
+
+#octahedral encoding of a unit vector as two signed bytes (decoded in the vertex shader):
+def oct_encode(n):
+	x, y, z = n
+	l = abs(x) + abs(y) + abs(z)
+	if l == 0.0: return (0, 0)
+	x /= l
+	y /= l
+	if z < 0.0:
+		x, y = (1.0 - abs(y)) * (1.0 if x >= 0.0 else -1.0), (1.0 - abs(x)) * (1.0 if y >= 0.0 else -1.0)
+	return (int(round(x * 127.0)), int(round(y * 127.0)))
+
+#reorder triangles so vertices get re-used while they are still in the post-transform cache:
+# (Tom Forsyth's "Linear-Speed Vertex Cache Optimisation")
+def optimize_triangle_order(indices, vertex_count):
+	CACHE_SIZE = 32
+	triangle_count = len(indices) // 3
+
+	vertex_triangles = [[] for v in range(0, vertex_count)]
+	for t in range(0, triangle_count):
+		for v in indices[3*t:3*t+3]:
+			vertex_triangles[v].append(t)
+
+	cache_position = [-1] * vertex_count
+	def vertex_score(v):
+		remaining = len(vertex_triangles[v])
+		if remaining == 0: return -1.0
+		score = 0.0
+		p = cache_position[v]
+		if p >= 0:
+			#the last triangle's vertices get a fixed score, so the next triangle doesn't just re-use them:
+			if p < 3: score = 0.75
+			else: score = (1.0 - (p - 3) / (CACHE_SIZE - 3)) ** 1.5
+		#boost vertices with few triangles left, so they get finished off:
+		score += 2.0 * remaining ** -0.5
+		return score
+
+	vertex_scores = [vertex_score(v) for v in range(0, vertex_count)]
+	triangle_scores = [sum(vertex_scores[v] for v in indices[3*t:3*t+3]) for t in range(0, triangle_count)]
+	added = [False] * triangle_count
+
+	cache = []
+	order = []
+	best = max(range(0, triangle_count), key=lambda t: triangle_scores[t], default=None)
+	while best != None:
+		added[best] = True
+		tri = indices[3*best:3*best+3]
+		order += tri
+		for v in tri:
+			vertex_triangles[v].remove(best)
+
+		#move triangle's vertices to the front of the cache:
+		cache = tri + [v for v in cache if v not in tri]
+		evicted = cache[CACHE_SIZE:]
+		cache = cache[:CACHE_SIZE]
+		for v in evicted:
+			cache_position[v] = -1
+		for i, v in enumerate(cache):
+			cache_position[v] = i
+
+		#rescore affected vertices and triangles; the next triangle is the best one touching the cache:
+		best = None
+		changed = set()
+		for v in cache + evicted:
+			vertex_scores[v] = vertex_score(v)
+			changed.update(vertex_triangles[v])
+		for t in changed:
+			triangle_scores[t] = sum(vertex_scores[v] for v in indices[3*t:3*t+3])
+			if best == None or triangle_scores[t] > triangle_scores[best]:
+				best = t
+		if best == None:
+			#(nothing left near the cache, so start somewhere new)
+			best = max((t for t in range(0, triangle_count) if not added[t]), key=lambda t: triangle_scores[t], default=None)
+
+	return order
+
+#average post-transform cache misses per triangle for a FIFO cache (for reporting):
+def acmr(indices, cache_size = 16):
+	if len(indices) == 0: return 0.0
+	cache = []
+	misses = 0
+	for v in indices:
+		if v not in cache:
+			misses += 1
+			cache = [v] + cache[:cache_size-1]
+	return misses / (len(indices) / 3)
+
+#convert a '.pnct'-format triangle list into (quantized vertices, indices, min, max):
+def pack_indexed(pnct):
+	count = len(pnct) // PNCT_SIZE
+	vertices = [struct.unpack('3f3f4B2f', pnct[i*PNCT_SIZE:(i+1)*PNCT_SIZE]) for i in range(0, count)]
+
+	mins = [min(v[c] for v in vertices) for c in range(0,3)] if count else [0.0, 0.0, 0.0]
+	maxs = [max(v[c] for v in vertices) for c in range(0,3)] if count else [0.0, 0.0, 0.0]
+
+	#quantize, then merge identical vertices:
+	unique = {}
+	quantized = []
+	triangles = []
+	for v in vertices:
+		pos = []
+		for c in range(0,3):
+			extent = maxs[c] - mins[c]
+			pos.append(int(round((v[c] - mins[c]) / extent * 65535.0)) if extent > 0.0 else 0)
+		ox, oy = oct_encode(v[3:6])
+		q = struct.pack('3HH4b4B2e', *pos, 0, ox, oy, 0, 0, *v[6:10], *v[10:12])
+		if q not in unique:
+			unique[q] = len(quantized)
+			quantized.append(q)
+		triangles.append(unique[q])
+
+	before = acmr(triangles)
+	triangles = optimize_triangle_order(triangles, len(quantized))
+	print("  " + str(count) + " vertices -> " + str(len(quantized)) + " unique; ACMR " + "{:.2f}".format(before) + " -> " + "{:.2f}".format(acmr(triangles)))
+
+	#renumber vertices in the order they are used, so vertex fetches are mostly sequential too:
+	renumber = {}
+	for v in triangles:
+		if v not in renumber: renumber[v] = len(renumber)
+	ordered = [None] * len(quantized)
+	for old, new in renumber.items():
+		ordered[new] = quantized[old]
+	triangles = [renumber[v] for v in triangles]
+
+	return (ordered, triangles, mins, maxs)
+
 bpy.ops.wm.open_mainfile(filepath=infile)
 
 if collection_name:
@@ -97,6 +228,9 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
+#(indexed output) quantized vertices, indices, and bounds of each mesh:
+packed = []
+
 vertex_count = 0
 for obj in bpy.data.objects:
 	if obj.data in to_write:
@@ -160,6 +294,7 @@ for obj in bpy.data.objects:
 			print("WARNING: object '" + name + "' has multiple texture coordinate layers; only exporting '" + obj.data.uv_layers.active.name + "'")
 
 	local_data = b''
+	mesh_data_begin = len(data)
 
 	#write the mesh triangles:
 	for poly in mesh.polygons:
@@ -191,26 +326,55 @@ for obj in bpy.data.objects:
 
 	index += struct.pack('I', vertex_count) #vertex_end
 
+	if indexed: packed.append(pack_indexed(b''.join(data[mesh_data_begin:])))
+
 data = b''.join(data)
 
 #check that code created as much data as anticipated:
 assert(vertex_count * (4*3+4*3+1*4+4*2) == len(data))
 
-#write the data chunk and index chunk to an output blob:
+if indexed:
+	#indices are relative to each mesh's first vertex, so can be 16-bit as long as no mesh is too big:
+	wide = any(len(vertices) > 65536 for (vertices, indices, mins, maxs) in packed)
+
+	vertex_data = []
+	index_data = []
+	entries = b''
+	vertex_begin = 0
+	index_begin = 0
+	for (i, (vertices, indices, mins, maxs)) in enumerate(packed):
+		name_begin, name_end = struct.unpack('II', index[16*i:16*i+8])
+		vertex_data += vertices
+		index_data.append(struct.pack(('I' if wide else 'H') * len(indices), *indices))
+		entries += struct.pack('6I', name_begin, name_end, vertex_begin, vertex_begin + len(vertices), index_begin, index_begin + len(indices))
+		entries += struct.pack('3f3f', *mins, *maxs)
+		vertex_begin += len(vertices)
+		index_begin += len(indices)
+	vertex_data = b''.join(vertex_data)
+	index_data = b''.join(index_data)
+
+	#(vertex data goes first, so it stays aligned)
+	chunks = [
+		(b'qvtx', vertex_data),
+		(b'ix32' if wide else b'ix16', index_data),
+		(b'str0', strings),
+		(b'idx1', entries),
+	]
+else:
+	#first chunk: the data; second chunk: the strings; third chunk: the index
+	chunks = [
+		(b'pnct', data),
+		(b'str0', strings),
+		(b'idx0', index),
+	]
+
+#write the chunks to an output blob:
 blob = open(outfile, 'wb')
-#first chunk: the data
-blob.write(struct.pack('4s',b'pnct')) #type
-blob.write(struct.pack('I', len(data))) #length
-blob.write(data)
-#second chunk: the strings
-blob.write(struct.pack('4s',b'str0')) #type
-blob.write(struct.pack('I', len(strings))) #length
-blob.write(strings)
-#third chunk: the index
-blob.write(struct.pack('4s',b'idx0')) #type
-blob.write(struct.pack('I', len(index))) #length
-blob.write(index)
+for (magic, chunk) in chunks:
+	blob.write(struct.pack('4s', magic)) #type
+	blob.write(struct.pack('I', len(chunk))) #length
+	blob.write(chunk)
 wrote = blob.tell()
 blob.close()
 
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(wrote) + " bytes [== " + " + ".join(str(len(chunk)+8) + " bytes of " + magic.decode() for (magic, chunk) in chunks) + "] to '" + outfile + "'")
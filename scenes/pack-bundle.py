@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+
+#Packs the meshes from a '.pnct' file into a '.bundle' file (see MeshBundle.hpp), so they can be loaded one at a time.
+#Usage:
+#python3 pack-bundle.py <infile.pnct> <outfile.bundle>
+
+import sys,struct,zlib
+
+if len(sys.argv) != 3:
+	print("\n\nUsage:\npython3 pack-bundle.py <infile.pnct> <outfile.bundle>\nRepacks the meshes in a '.pnct' file as a mesh bundle.\n")
+	exit(1)
+
+infile = sys.argv[1]
+outfile = sys.argv[2]
+
+VERTEX_SIZE = 3*4+3*4+4*1+2*4
+
+#---- read .pnct ----
+
+blob = open(infile, 'rb').read()
+chunks = {}
+at = 0
+while at < len(blob):
+	magic, length = struct.unpack('4sI', blob[at:at+8])
+	chunks[magic] = blob[at+8:at+8+length]
+	at += 8 + length
+
+data = chunks[b'pnct']
+strings = chunks[b'str0']
+index = chunks[b'idx0']
+
+meshes = []
+for i in range(0, len(index), 16):
+	name_begin, name_end, vertex_begin, vertex_end = struct.unpack('IIII', index[i:i+16])
+	name = strings[name_begin:name_end]
+	vertices = data[vertex_begin*VERTEX_SIZE:vertex_end*VERTEX_SIZE]
+	mins = [float('inf')] * 3
+	maxs = [float('-inf')] * 3
+	for v in range(0, len(vertices), VERTEX_SIZE):
+		pos = struct.unpack('fff', vertices[v:v+12])
+		mins = [min(a,b) for a,b in zip(mins, pos)]
+		maxs = [max(a,b) for a,b in zip(maxs, pos)]
+	meshes.append((name, vertex_end - vertex_begin, vertices, mins, maxs))
+
+#---- build bundle ----
+
+#must match hash_name() in hash_name.hpp:
+def hash_name(name):
+	h = 2166136261
+	for c in name:
+		h = ((h ^ c) * 16777619) & 0xffffffff
+	return 1 if h == 0 else h
+
+#table of contents is at most half full, so probe sequences stay short:
+slots = 1
+while slots < 2 * len(meshes):
+	slots *= 2
+
+EMPTY = struct.pack('IIIIIIII6f', 0,0,0,0,0,0,0,0, 0,0,0,0,0,0)
+toc = [EMPTY] * slots
+names = b''
+dat = b''
+raw_size = 0
+hashed = {}
+
+for (name, count, vertices, mins, maxs) in meshes:
+	h = hash_name(name)
+	#meshes are looked up by hash alone, so hashes must be unique:
+	if h in hashed:
+		print("ERROR: mesh names '" + hashed[h].decode() + "' and '" + name.decode() + "' have the same hash; please rename one.")
+		exit(1)
+	hashed[h] = name
+	slot = h & (slots - 1)
+	while toc[slot] != EMPTY:
+		slot = (slot + 1) & (slots - 1)
+
+	name_begin = len(names)
+	names += name
+	name_end = len(names)
+
+	#compress only when it helps:
+	compressed = zlib.compress(vertices, 9)
+	if len(compressed) < len(vertices):
+		compression = 1
+		stored = compressed
+	else:
+		compression = 0
+		stored = vertices
+	if count == 0: mins = maxs = [0,0,0]
+
+	data_begin = len(dat)
+	dat += stored
+	data_end = len(dat)
+	raw_size += len(vertices)
+
+	toc[slot] = struct.pack('IIIIIIII6f', h, name_begin, name_end, count, data_begin, data_end, compression, 0, *mins, *maxs)
+
+toc = b''.join(toc)
+
+#---- write ----
+
+out = open(outfile, 'wb')
+for magic, chunk in [(b'toc0', toc), (b'str0', names), (b'dat0', dat)]:
+	out.write(struct.pack('4s', magic)) #type
+	out.write(struct.pack('I', len(chunk))) #length
+	out.write(chunk)
+
+print("Wrote " + str(len(meshes)) + " meshes (" + str(len(dat)) + " bytes of vertex data, from " + str(raw_size) + ") to '" + outfile + "'.")
@@ -4,12 +4,16 @@
 #include "hex_dump.hpp"
 
 #include "Game.hpp"
+#include "Replay.hpp"
+#include "TickScheduler.hpp"
 
-#include <chrono>
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
 #include <unordered_map>
+#include <random>
+#include <memory>
+#include <algorithm>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -32,8 +36,8 @@ int main(int argc, char **argv) {
 
 	//------------ argument parsing ------------
 
-	if (argc != 2) {
-		std::cerr << "Usage:\n\t./server <port>" << std::endl;
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage:\n\t./server <port> [record.replay]" << std::endl;
 		return 1;
 	}
 
@@ -48,21 +52,35 @@ int main(int argc, char **argv) {
 	//keep track of game state:
 	Game game;
 
+	//a fresh seed each run so decks differ; recorded so replays can reproduce them:
+	uint32_t seed = std::random_device()();
+	game.mt.seed(seed);
+
+	//optionally record a log for ./replay :
+	std::unique_ptr< ReplayRecorder > recorder;
+	if (argc == 3) {
+		recorder.reset(new ReplayRecorder(argv[2], seed));
+		std::cout << "Recording replay to '" << argv[2] << "'." << std::endl;
+	}
+
+	//ticks on a fixed grid; after a hiccup, runs up to three late ticks back-to-back before skipping:
+	TickScheduler scheduler(Game::Tick, 3);
+	uint64_t reported_skipped = 0;
+
 	while (true) {
-		static auto next_tick = std::chrono::steady_clock::now() + std::chrono::duration< double >(Game::Tick);
-		//process incoming data from clients until a tick has elapsed:
-		while (true) {
-			auto now = std::chrono::steady_clock::now();
-			double remain = std::chrono::duration< double >(next_tick - now).count();
-			if (remain < 0.0) {
-				next_tick += std::chrono::duration< double >(Game::Tick);
-				break;
-			}
+		//process incoming data from clients until a tick is due:
+		uint32_t ticks;
+		while ((ticks = scheduler.advance()) == 0) {
+			double remain = std::max(0.0, scheduler.remaining());
+			//when the scheduler's timer can wake poll(), the timeout is only a fallback,
+			// so pad it slightly to avoid waking up twice for the same deadline:
+			if (scheduler.wake_fd() >= 0) remain += 0.002;
 
 			//helper used on client close (due to quit) and server close (due to error):
 			auto remove_connection = [&](Connection *c) {
 				auto f = connection_to_player.find(c);
 				assert(f != connection_to_player.end());
+				if (recorder) recorder->remove(f->second);
 				game.remove_player(f->second);
 				connection_to_player.erase(f);
 			};
@@ -74,7 +92,9 @@ int main(int argc, char **argv) {
 					game.this_sux.x = 1.0f;
 
 					//create some player info for them:
-					connection_to_player.emplace(c, game.spawn_player());
+					Player *player = game.spawn_player();
+					if (recorder) recorder->spawn(player);
+					connection_to_player.emplace(c, player);
 
 				} else if (evt == Connection::OnClose) {
 					//client disconnected:
@@ -104,11 +124,20 @@ int main(int argc, char **argv) {
 						remove_connection(c);
 					}
 				}
-			}, remain);
+			}, remain, scheduler.wake_fd());
 		}
 
-		//update current game state
-		game.update(Game::Tick);
+		if (scheduler.skipped != reported_skipped) {
+			std::cout << "WARNING: server fell behind; skipped " << (scheduler.skipped - reported_skipped) << " tick(s) (" << scheduler.skipped << " of " << (scheduler.ticks + scheduler.skipped) << " so far)." << std::endl;
+			reported_skipped = scheduler.skipped;
+		}
+
+		//update current game state (once per tick, including ticks being caught up)
+		for (uint32_t t = 0; t < ticks; ++t) {
+			if (recorder) recorder->begin_tick(game);
+			game.update(Game::Tick);
+			if (recorder) recorder->end_tick(game);
+		}
 
 		//send updated game state to all clients
 		for (auto &[c, player] : connection_to_player) {